@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "token.h"
+#include "lexer.h"
+#include "utils/file_utils.h"
+#include "utils/intern.h"
+
+#define DEFAULT_SOURCE_SIZE (32 * 1024 * 1024)
+#define RUNS 5
+
+/**
+ * A piece of typical source, repeated to build the synthetic input.
+ */
+static const char *snippet =
+    "// Synthetic benchmark input\n"
+    "class Point(x, y) {\n"
+    "    def length do x * x + y * y;\n"
+    "    def move(dx, dy) {\n"
+    "        set x = x + dx;\n"
+    "        set y = y + dy;\n"
+    "    }\n"
+    "}\n"
+    "def fib(n) {\n"
+    "    if (n <= 1) { return n; }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "points = [Point(1, 2), Point(3.5, 4.25)];\n"
+    "config = {\"name\": \"quokka\", \"version\": 2, \"debug\": false};\n"
+    "total = 0;\n"
+    "for (i = 0; i < 100; i++) {\n"
+    "    total += i % 7 == 0 && i != 14 ? i : 1;\n"
+    "}\n"
+    "while (total >= 10) { total -= 10; }\n"
+    ">> total;\n";
+
+static char *generate_source(size_t size) {
+    size_t snippet_length = strlen(snippet);
+    size_t copies = size / snippet_length + 1;
+
+    char *source = malloc(copies * snippet_length + 1);
+    if (!source) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < copies; i++) {
+        memcpy(source + i * snippet_length, snippet, snippet_length);
+    }
+    source[copies * snippet_length] = '\0';
+    return source;
+}
+
+static double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * Measures lexer throughput. Usage: lexer_bench [file.qk]
+ * Without a file a synthetic source of DEFAULT_SOURCE_SIZE bytes is lexed.
+ */
+int main(int argc, char *argv[]) {
+    char *source = argc > 1 ? read_file(argv[1]) : generate_source(DEFAULT_SOURCE_SIZE);
+    if (!source) return 1;
+
+    size_t length = strlen(source);
+    double best = 0;
+    int token_count = 0;
+
+    for (int run = 0; run < RUNS; run++) {
+        double start = now();
+        Token *tokens = tokenize(source, &token_count);
+        double elapsed = now() - start;
+
+        free_tokens(tokens, token_count);
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+
+    double megabytes = length / (1024.0 * 1024.0);
+    printf("Lexed %.1f MB into %d tokens\n", megabytes, token_count);
+    printf("Best of %d runs: %.3f s, %.1f MB/s, %.1f M tokens/s\n",
+           RUNS, best, megabytes / best, token_count / best / 1e6);
+
+    free(source);
+    intern_free_all();
+    return 0;
+}
\ No newline at end of file
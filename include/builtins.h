@@ -0,0 +1,18 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "utils/call_stack.h"
+
+/**
+ * Functions written in C that every program can call by name. They are bound
+ * in the main frame before the program runs, so a program that defines a name
+ * of its own hides the builtin.
+ */
+
+/**
+ * @brief Bind every builtin in a frame.
+ * @param globals The main frame.
+ */
+void define_builtins(StackFrame *globals);
+
+#endif
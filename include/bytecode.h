@@ -0,0 +1,87 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "token.h"
+
+/**
+ * Instructions are a single opcode byte followed by zero or more 32-bit operands.
+ * Jump operands are byte offsets relative to the end of the instruction.
+ * Variables use the slot assigned by the resolver: LOCAL slots belong to the
+ * scope of the chunk, GLOBAL slots to the main program and NAME is looked up.
+ */
+typedef enum {
+    BC_CONSTANT,        // [const]         push constants[const]
+    BC_NONE,            //                 push NULL
+    BC_POP,             //                 discard top of stack
+
+    BC_LOAD_LOCAL,      // [slot]          push variable, calling it if it is a function or class
+    BC_LOAD_GLOBAL,     // [slot]
+    BC_LOAD_NAME,       // [name]
+    BC_GET_LOCAL,       // [slot]          push variable without calling it
+    BC_GET_GLOBAL,      // [slot]
+    BC_GET_NAME,        // [name]
+    BC_SET_LOCAL,       // [slot]          bind top of stack in the current frame
+    BC_SET_NAME,        // [name]
+    BC_SET_FIELD,       // [name]          bind top of stack on self
+
+    BC_JUMP_IF_NOT_CALLABLE, // [offset]   skip the argument list of a non-callable
+    BC_CALL,            // [argc]          call function or class below the arguments
+    BC_MEMBER,          // [name][offset]  replace object with member, jumping if it is not a method
+    BC_CALL_METHOD,     // [argc]          call method pushed by BC_MEMBER
+    BC_TAIL_CALL,       // [argc]          BC_CALL that reuses the frames of the function returning its result
+
+    BC_ADD, BC_SUB, BC_MUL, BC_DIV, BC_MOD,
+    BC_GT, BC_GTE, BC_LT, BC_LTE,
+    BC_EQ, BC_NEQ,
+    BC_NOT,
+
+    BC_LIST,            // [count]         build list from the top count values
+    BC_MAP,             // [count]         build map from the top count key value pairs
+    BC_INDEX,           //                 container[index]
+    BC_SET_INDEX,       //                 container[index] = value
+
+    BC_JUMP,            // [offset]
+    BC_JUMP_IF_FALSE,   // [offset]        pops the condition
+    BC_LOOP,            // [offset]        jump backwards
+
+    BC_OUT,
+    BC_IN,
+    BC_IMPORT,
+    BC_RETURN
+} OpCode;
+
+typedef struct Chunk {
+    uint8_t *code;
+    ParseNode **nodes;  // Source node of each instruction, for errors and call names
+    int count;
+    int capacity;
+
+    Value *constants;
+    int constant_count;
+    int constant_capacity;
+
+    Scope *scope;       // Scope of the LOCAL slots, NULL if the code binds by name
+} Chunk;
+
+Chunk *chunk_create(void);
+void chunk_write(Chunk *chunk, uint8_t byte, ParseNode *node);
+void chunk_write_operand(Chunk *chunk, uint32_t operand, ParseNode *node);
+void chunk_patch_operand(Chunk *chunk, int offset, uint32_t operand);
+int chunk_add_constant(Chunk *chunk, Value value);
+void chunk_destroy(Chunk *chunk);
+
+void disassemble_chunk(Chunk *chunk, const char *name);
+
+/**
+ * @brief Read the operand an instruction stores after its opcode. Inline, as
+ *        the dispatch loop reads one for most instructions it runs.
+ */
+static inline uint32_t chunk_read_operand(const uint8_t *ip) {
+    uint32_t operand;
+    memcpy(&operand, ip, sizeof(uint32_t));
+    return operand;
+}
+
+#endif
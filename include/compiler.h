@@ -0,0 +1,22 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "token.h"
+#include "bytecode.h"
+
+/**
+ * @brief Lowers an AST produced by parse() into a chunk of bytecode
+ * @param node The root node of the AST
+ * @return The compiled chunk, owned by the caller
+ */
+Chunk *compile(ParseNode *node);
+
+/**
+ * @brief Compiles the body of a function or class definition on first use
+ *        and caches the chunk on the definition node
+ * @param definition A FUNCTION or CLASS node
+ * @return The compiled body, owned by the node
+ */
+Chunk *compile_body(ParseNode *definition);
+
+#endif
@@ -2,19 +2,45 @@
 #define EVALUATOR_H
 
 #include "token.h"
+#include "utils/call_stack.h"
 #include <stdbool.h>
 
+extern CallStack *callStack;
+
 void set_debug_mode_evaluator(bool debug);
+void init_call_stack(Scope *globals);
 
 /**
  * @brief Evaluates a given AST to a return value
  * @param node The root node of the AST
  * @return The evaluated value
  */
-Value *evaluate(ParseNode *node);
+Value evaluate(ParseNode *node);
+
+Value execute_function(ParseNode *node, Value id_value);
+Value execute_native(ParseNode *node, Value native);
+Value create_class(ParseNode *node);
+Value build_object(ParseNode *node, Value class);
+Value call_object(ParseNode *node);
+Value evaluate_in(ParseNode *node);
+void assign_variable(ParseNode *identifier, Value value);
+ParseNode *load_import(ParseNode *node);
+void free_imports();
+
+// Operations on already evaluated operands, shared with the virtual machine.
+// The node is the operator node and is used for its type and error reporting.
+Value apply_op_add(ParseNode *node, Value left, Value right);
+Value apply_op_binary(ParseNode *node, Value left, Value right);
+Value apply_op_eq(ParseNode *node, Value left, Value right);
+Value apply_op_not(Value operand);
+Value apply_op_index(ParseNode *node, Value container, Value index);
+Value apply_index_assignment(ParseNode *node, Value container, Value index, Value value);
+Value apply_set(ParseNode *node, Value rhs);
+Value apply_out(ParseNode *node, Value to_out);
+bool is_truthy(Value value);
 
-Value *execute_function(ParseNode *node, Value *id_value);
-Value *build_object(ParseNode *node, Value *class);
-Value *call_object(ParseNode *node);
+void runtime_error(ParseNode *node, char* string);
+void cleanup();
+void error_and_exit(ParseNode *node, char* string);
 
-#endif
\ No newline at end of file
+#endif
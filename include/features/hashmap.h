@@ -3,16 +3,16 @@
 
 #include <stddef.h>
 #include "token.h"
-#include "utils/pair.h"
+#include "utils/table.h"
 
 typedef struct HashMap {
-    size_t size;
-    Pair **buckets;
+    Table table;
 } HashMap;
 
 HashMap *hashmap_create(size_t size);
-void hashmap_set(HashMap *hashmap, char *key, Value *value);
-int hashmap_get(HashMap *hashmap, const char *key, Value **out_value);
+void hashmap_set(HashMap *hashmap, char *key, Value value);
+int hashmap_get(HashMap *hashmap, const char *key, Value *out_value);
+int hashmap_delete(HashMap *hashmap, const char *key);
 void hashmap_destroy(HashMap *hashmap);
 
 #endif
\ No newline at end of file
@@ -5,16 +5,23 @@
 #include <stdio.h>
 
 typedef struct List {
-    Value **items;
-    int array_length;
-    int tail;
+    Value *items;
+    int array_length;   // Items allocated, doubled when the list is full
+    int tail;           // Index of the last item, -1 when empty
 } List;
 
-List *list_create(int length);
+// The fewest items a list allocates room for
+#define LIST_MIN_CAPACITY 4
+
+// The most items reserve() makes room for at once, 128 MB of values
+#define LIST_MAX_RESERVE (1 << 24)
+
+List *list_create(int capacity);
+void list_reserve(List *list, int capacity);
 void list_copy(List *original, List *target, int offset);
-void list_add(List **plist, Value *item);
-Value *list_access(List *list, int index);
-void list_edit(List *list, int index, Value *item);
+void list_add(List *list, Value item);
+Value list_access(List *list, int index);
+void list_edit(List *list, int index, Value item);
 void list_destroy(List *list);
 
 #endif
\ No newline at end of file
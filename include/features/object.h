@@ -0,0 +1,51 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdbool.h>
+#include "token.h"
+#include "utils/table.h"
+#include "utils/hash_table.h"
+
+typedef struct ShapeTransition {
+    char *name;     // Interned name of the field added
+    Shape *shape;
+} ShapeTransition;
+
+/**
+ * The hidden class of an object: the slot of each of its fields. Every class
+ * has a root shape without fields, and adding a field moves an object to the
+ * shape one transition further, so objects of a class whose fields are added
+ * in the same order share their shapes. Shapes live as long as the class node.
+ */
+struct Shape {
+    Table slots;                    // Field name to its slot, as an int value
+    int field_count;
+    HashTable *methods;             // Methods of the class, shared by all its shapes
+    ShapeTransition *transitions;
+    int transition_count;
+    int transition_capacity;
+};
+
+#define INLINE_CACHE_SIZE 4
+
+/**
+ * Where the member of an OP_DOT site was found for the last shapes seen
+ * there. Once a site has seen more shapes it looks members up by name.
+ */
+struct InlineCache {
+    Shape *shapes[INLINE_CACHE_SIZE];
+    int slots[INLINE_CACHE_SIZE];   // Slot of the field, -1 if the member is a method
+    Value methods[INLINE_CACHE_SIZE];
+    int count;
+};
+
+Shape *shape_create(HashTable *methods);
+int shape_find(Shape *shape, const char *name);
+void shape_destroy(Shape *root);
+
+Value object_create(Shape *shape);
+bool object_get_field(Obj *object, const char *name, Value *out_value);
+void object_set_field(Obj *object, char *name, Value value);
+bool object_member(ParseNode *site, Value object, const char *name, Value *out_member);
+
+#endif
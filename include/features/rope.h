@@ -0,0 +1,15 @@
+#ifndef ROPE_H
+#define ROPE_H
+
+#include <stddef.h>
+#include "value.h"
+
+// Concatenations shorter than this are copied right away instead
+#define ROPE_MIN_LENGTH 64
+
+Value rope_concat(Value left, Value right);
+size_t string_length(Value string);
+bool string_equal(Value left, Value right);
+char *rope_flatten(Obj *string);
+
+#endif
@@ -1,8 +1,18 @@
 #ifndef GARBAGE_COLLECTOR_H
 #define GARBAGE_COLLECTOR_H
 
-void gc_reference(Value *value);
-void gc_dereference(Value *value);
-Value *gc_malloc();
+#include "value.h"
+
+void gc_reference(Value value);
+void gc_dereference(Value value);
+Obj *gc_malloc();
+
+void gc_push_root(Value value);
+void gc_pop_roots(int count);
+void gc_add_roots(Value **values, int *count);
+void gc_remove_roots(Value **values);
+
+void gc_collect();
+void gc_free_all();
 
 #endif
\ No newline at end of file
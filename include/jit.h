@@ -0,0 +1,37 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include "token.h"
+#include "utils/call_stack.h"
+
+extern bool jit_enabled;
+
+void set_jit_mode(bool enabled);
+
+/**
+ * @brief Count a back-edge of a while or for loop. Once the loop is hot it is
+ *        compiled to native code, which then runs the remaining iterations.
+ * @param loop The WHILE or FOR node, about to test its condition again
+ * @param last The latest value of the loop body, updated by the native code
+ * @return true if the loop ran to completion natively, false to keep
+ *         interpreting it (not hot yet, unsupported or a type guard failed)
+ */
+bool jit_loop(ParseNode *loop, Value *last);
+
+/**
+ * @brief Count a call of a function. Once it is hot its body is compiled to
+ *        native code, which then runs in place of evaluating the body.
+ * @param definition The FUNCTION node being called
+ * @param frame The frame of the call, already on the call stack
+ * @param result The value of the body when it ran natively
+ * @return true if the body ran natively
+ */
+bool jit_call(ParseNode *definition, StackFrame *frame, Value *result);
+
+/**
+ * @brief Unmap all compiled code.
+ */
+void jit_free_all();
+
+#endif
@@ -4,17 +4,21 @@
 #include "token.h"
 #include <stdbool.h>
 
-Token* tokenize(char *input, int *token_count);
-
-
-// Token creation
-void add_token(TokenType type);
-void add_token_string(TokenType type, char *text);
-
-// Token scanners
-void number(void);
-void identifier(void);
-void string(void);
+/**
+ * The state of one source being scanned. Each lexer is independent, so any
+ * number of sources can be lexed at once.
+ */
+typedef struct Lexer {
+    const char *source;
+    int start;      // First character of the token being scanned
+    int current;    // Next character to read
+    int line;
+} Lexer;
+
+void lexer_init(Lexer *lexer, const char *source);
+bool lexer_next(Lexer *lexer, Token *token);
+
+Token* tokenize(const char *input, int *token_count);
 
 // Character classification
 bool isDigit(char c);
@@ -24,7 +28,7 @@ bool isAlphaNumeric(char c);
 // General string manipulation
 char* substring(const char *input, int left, int right);
 
-TokenType check_keyword(const char *str);
+TokenType check_keyword(const char *str, int length);
 
 void free_tokens(Token *tokens, int count);
 
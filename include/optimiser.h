@@ -0,0 +1,16 @@
+#ifndef OPTIMISER_H
+#define OPTIMISER_H
+
+#include "token.h"
+
+void set_optimisation_level(int level);
+
+/**
+ * @brief Folds constant expressions and prunes branches whose condition is a
+ *        constant, rewriting the tree in place. Does nothing at level 0.
+ * @param program The PROGRAM node returned by parse()
+ * @param arena The arena that owns the tree, folded strings are kept in it
+ */
+void optimise_program(ParseNode *program, Arena *arena);
+
+#endif
@@ -1,6 +1,13 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-ParseNode* parse(Token* tokens, int count);
+/**
+ * @brief Parse tokens into a syntax tree. The tokens may be freed afterwards.
+ * @param tokens The tokens from tokenize()
+ * @param count The number of tokens
+ * @param arena The arena that owns the tree, destroy it to free the tree
+ * @return The PROGRAM node
+ */
+ParseNode* parse(Token* tokens, int count, Arena *arena);
 
 #endif
\ No newline at end of file
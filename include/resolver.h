@@ -0,0 +1,42 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "token.h"
+#include <stdbool.h>
+
+/**
+ * The variables bound in the body of a program or function. Each name owns
+ * a fixed slot in the frames created for that body.
+ */
+typedef struct Scope {
+    char **names;
+    bool *shadowed; // Global scope only: name may also be bound by a frame above main
+    bool private;   // Function scope only: no other frame reads its variables by name
+    int count;
+    int capacity;
+
+    int *index;     // Open addressed name hash to slot, -1 when empty
+    int index_capacity;
+} Scope;
+
+/**
+ * @brief Assigns slots to the variables of a program and its functions
+ * @param program The PROGRAM node returned by parse()
+ * @return The global scope, also stored on the program node
+ */
+Scope *resolve_program(ParseNode *program);
+
+/**
+ * @brief Resolves an imported program. Its top level binds into whichever
+ *        frame runs the import, so only its functions get slots.
+ * @param program The PROGRAM node of the imported file
+ * @param globals The global scope of the main program
+ */
+void resolve_import(ParseNode *program, Scope *globals);
+
+Scope *scope_create();
+int scope_declare(Scope *scope, char *name);
+int scope_find(Scope *scope, const char *name);
+void scope_destroy(Scope *scope);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdbool.h>
+#include "value.h"
+#include "token.h"
+#include "resolver.h"
+#include "evaluator.h"
+#include "garbage_collector.h"
+#include "features/list.h"
+#include "utils/intern.h"
+
+/**
+ * Support for the C programs written by --emit-c. They keep their variables
+ * in the same call stack as the evaluator and share its operators, so a
+ * translated program behaves as the interpreted one.
+ */
+
+// The body of a translated function, run with its frame on top of the stack
+typedef Value (*NativeBody)(void);
+
+/**
+ * @brief Create the scope the resolver built, declaring its names in slot order.
+ * @param names The names of the slots, interned here
+ * @param shadowed Per slot, whether a frame above main may bind the name, NULL for none
+ * @param count The number of slots
+ */
+Scope *rt_scope(char **names, const bool *shadowed, int count);
+
+/**
+ * @brief Fill in a node used by the runtime for its type, line and variable.
+ */
+void rt_node(ParseNode *node, TokenType type, int line, const char *name, Scope *scope, int slot);
+
+/**
+ * @brief Create the main frame and record the bodies of the translated
+ *        functions, indexed by the slot of their FUNCTION node.
+ */
+void rt_start(Scope *globals, const NativeBody *bodies);
+
+/**
+ * @brief Tear down the runtime once the program ends, as the interpreter does.
+ * @return The exit status of the program.
+ */
+int rt_finish(Value result);
+
+/**
+ * @brief A string constant, kept alive until the program ends.
+ */
+Value rt_string(const char *chars);
+
+/**
+ * @brief Read a variable, exiting if it is not declared.
+ */
+Value rt_lookup(ParseNode *identifier);
+
+/**
+ * @brief The number of arguments a call binds, which are the only ones
+ *        evaluated. Builtins bind every argument, values other than
+ *        functions none.
+ */
+int rt_arity(Value callee, int argc);
+
+/**
+ * @brief Call a translated function or a builtin.
+ * @param site The identifier of the call, naming the frame
+ * @param callee The function or builtin value
+ * @param args The arguments to bind, each already a GC root
+ * @param argc The number of arguments from rt_arity()
+ */
+Value rt_call(ParseNode *site, Value callee, Value *args, int argc);
+
+/**
+ * @brief Hand a translated function called in tail position over to the
+ *        rt_call() running the caller, which runs it in the same frame once
+ *        the caller's body has unwound. Like evaluate_return(), only emitted
+ *        for returns the resolver marked in private functions.
+ * @param site The identifier of the call, naming the frame
+ * @param callee The function value
+ * @param args The arguments to bind, copied before the body unwinds
+ * @param argc The number of arguments from rt_arity()
+ * @return none, the value of the call is that of the rt_call() running it
+ */
+Value rt_tail_call(ParseNode *site, Value callee, Value *args, int argc);
+
+/**
+ * @brief Define a function and bind it to its name.
+ */
+Value rt_function(ParseNode *definition);
+
+Value rt_list(int capacity);
+Value rt_map();
+
+/**
+ * @brief Add a pair to a map literal.
+ * @return false after reporting an error if the key is not a string.
+ */
+bool rt_map_set(ParseNode *pair, Value map, Value key, Value value);
+
+/**
+ * @brief Mark the frame on top as returning.
+ */
+void rt_return();
+
+/**
+ * @brief Whether a return ran in the frame on top, which leaves every
+ *        statement list and loop up to the end of the call.
+ */
+bool rt_returned();
+
+/**
+ * @brief The slots of the frame on top of the stack.
+ */
+Value *rt_slots();
+
+#endif
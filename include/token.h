@@ -3,9 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-
-typedef struct HashTable HashTable;
-typedef struct HashMap HashMap;
+#include "value.h"
 
 typedef enum {
     // General
@@ -72,6 +70,13 @@ typedef enum {
     IN,
     OUT,
 
+    // Arithmetic specialised for int or float operands, see quicken()
+    OP_ADD_INT, OP_SUB_INT, OP_MUL_INT, OP_DIV_INT, OP_MOD_INT,
+    OP_GT_INT, OP_GTE_INT, OP_LT_INT, OP_LTE_INT,
+    OP_EQ_INT, OP_NEQ_INT,
+    OP_ADD_FLOAT, OP_SUB_FLOAT, OP_MUL_FLOAT, OP_DIV_FLOAT,
+    OP_GT_FLOAT, OP_GTE_FLOAT, OP_LT_FLOAT, OP_LTE_FLOAT,
+
     // Misc
     CONTROL,
     IMPORT,
@@ -81,58 +86,131 @@ typedef enum {
 int is_operator(TokenType type);
 int is_compound_assignment_operator(TokenType type);
 
-typedef enum {
-    TYPE_NONE,
-    TYPE_INT,
-    TYPE_FLOAT,
-    TYPE_STRING,
-    TYPE_BOOL,
-    TYPE_LIST,
-    TYPE_MAP,
-    TYPE_FUNCTION,
-    TYPE_CLASS,
-    TYPE_OBJECT,
-    TYPE_METADATA
-} ValueType;
-
-typedef struct ParseNode ParseNode;
-typedef struct List List;
-
-typedef struct Value {
-    ValueType type;
-    int references;
-    union {
-        int intValue;
-        double floatValue;
-        char *stringValue;
-        ParseNode *node;
-        HashTable *object_fields;
-        List *list;
-        HashMap *map;
-    } data;
-} Value;
-
-Value *value_create(ValueType value);
-Value *value_copy(Value *old);
-void print_value(Value *value);
-void value_destroy(Value value);
+typedef struct Chunk Chunk;
+typedef struct Scope Scope;
+typedef struct Arena Arena;
+typedef struct InlineCache InlineCache;
 
+/**
+ * A token is a view of its characters in the source. Only identifiers and
+ * strings, which outlive the source in the syntax tree, are copied into the
+ * intern table.
+ */
 typedef struct Token {
     TokenType category;
-    char *text;
     int line;
+    int length;
+    const char *start;  // First character in the source, not null terminated
+    char *text;         // Interned copy for identifiers and strings, otherwise NULL
 } Token;
 
+// Position of a node in the node store, 0 for no node
+typedef uint32_t NodeIndex;
+
+/**
+ * What a node refers to besides its children, kept apart from the node in the
+ * payload pool. Only identifiers, literals, definitions, imports and member
+ * accesses have one, so most nodes carry a 4 byte index instead of 24 bytes.
+ */
+typedef struct NodePayload {
+    union {
+        char *name;    // Interned name of an IDENTIFIER
+        Value literal; // Value of a LITERAL, strings point to an Obj in the arena of the file
+    };
+    union {
+        Chunk *code;          // Compiled body of FUNCTION and CLASS nodes, see compile_body()
+        InlineCache *cache;   // Where the members of an OP_DOT were found, see object_member()
+    };
+    union {
+        Scope *scope;         // Owned by PROGRAM and FUNCTION nodes, resolved scope of IDENTIFIER nodes
+        Shape *shape;         // Root shape of a CLASS node, see create_class()
+    };
+} NodePayload;
+
+/**
+ * A node of the syntax tree, 28 bytes. Nodes of every file sit in one array in
+ * the order they were parsed and refer to each other by 32-bit index, so a
+ * traversal mostly walks forwards through memory. Read the children and the
+ * payload with the node_* functions below.
+ */
 struct ParseNode {
-    TokenType type;
-    Value value;
-    struct ParseNode *left;
-    struct ParseNode *right;
-    int line;
+    NodeIndex left;
+    NodeIndex right;
+    uint32_t items;         // First of item_count indices in the item pool: statements,
+                             // elements, map pairs, or the arguments of an identifier
+    int item_count;
+    int slot;                // Variable slot within scope, -1 when looked up by name
+    uint32_t payload;        // Index in the payload pool, 0 while the node has none
+    uint32_t line : 23;
+    uint32_t unstable : 1;   // Operand types changed after quickening, so it stays generic
+    uint32_t type : 8;       // The TokenType, which fits in a byte
 };
 
-ParseNode *parse_node_create(TokenType type);
+/**
+ * The nodes, payloads and item lists of every syntax tree in the process. Each
+ * array is reserved at its largest up front and only touched as it fills, so
+ * it never moves and a node can be held by pointer as well as by index. Index
+ * 0 of each is unused: a node index of 0 is no node, and payload 0 reads as
+ * all NULL.
+ */
+typedef struct NodeStore {
+    ParseNode *nodes;
+    uint32_t node_count;
+    NodePayload *payloads;
+    uint32_t payload_count;
+    NodeIndex *items;
+    uint32_t item_count;
+} NodeStore;
+
+extern NodeStore node_store;
+
+ParseNode *node_store_alloc(int count);
+NodePayload *node_payload_create(ParseNode *node);
+void node_set_items(ParseNode *node, ParseNode **items, int count);
+void node_store_free();
+
+static inline ParseNode *node_at(NodeIndex index) {
+    return index != 0 ? &node_store.nodes[index] : NULL;
+}
+
+static inline NodeIndex node_index(ParseNode *node) {
+    return node != NULL ? (NodeIndex)(node - node_store.nodes) : 0;
+}
+
+static inline ParseNode *node_left(ParseNode *node) { return node_at(node->left); }
+static inline ParseNode *node_right(ParseNode *node) { return node_at(node->right); }
+static inline void node_set_left(ParseNode *node, ParseNode *child) { node->left = node_index(child); }
+static inline void node_set_right(ParseNode *node, ParseNode *child) { node->right = node_index(child); }
+
+/**
+ * @brief The child at a position of the items of a node, below item_count.
+ */
+static inline ParseNode *node_item(ParseNode *node, int i) {
+    return node_at(node_store.items[node->items + i]);
+}
+
+// Reading a field of a node without a payload gives NULL
+#define NODE_PAYLOAD(node) (&node_store.payloads[(node)->payload])
+
+static inline char *node_name(ParseNode *node) { return NODE_PAYLOAD(node)->name; }
+static inline Value node_literal(ParseNode *node) { return NODE_PAYLOAD(node)->literal; }
+static inline Chunk *node_code(ParseNode *node) { return NODE_PAYLOAD(node)->code; }
+static inline InlineCache *node_cache(ParseNode *node) { return NODE_PAYLOAD(node)->cache; }
+static inline Scope *node_scope(ParseNode *node) { return NODE_PAYLOAD(node)->scope; }
+static inline Shape *node_shape(ParseNode *node) { return NODE_PAYLOAD(node)->shape; }
+
+// Setting a field gives the node a payload of its own first
+#define NODE_PAYLOAD_FOR_WRITE(node) ((node)->payload != 0 ? NODE_PAYLOAD(node) : node_payload_create(node))
+
+static inline void node_set_name(ParseNode *node, char *name) { NODE_PAYLOAD_FOR_WRITE(node)->name = name; }
+static inline void node_set_literal(ParseNode *node, Value literal) { NODE_PAYLOAD_FOR_WRITE(node)->literal = literal; }
+static inline void node_set_code(ParseNode *node, Chunk *code) { NODE_PAYLOAD_FOR_WRITE(node)->code = code; }
+static inline void node_set_cache(ParseNode *node, InlineCache *cache) { NODE_PAYLOAD_FOR_WRITE(node)->cache = cache; }
+static inline void node_set_scope(ParseNode *node, Scope *scope) { NODE_PAYLOAD_FOR_WRITE(node)->scope = scope; }
+static inline void node_set_shape(ParseNode *node, Shape *shape) { NODE_PAYLOAD_FOR_WRITE(node)->shape = shape; }
+
+ParseNode *parse_node_create(Arena *arena, TokenType type);
+Value string_literal_create(Arena *arena, char *text);
 void print_ast(ParseNode *node);
-void free_ast(ParseNode *node);
 
 #endif
\ No newline at end of file
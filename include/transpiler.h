@@ -0,0 +1,17 @@
+#ifndef TRANSPILER_H
+#define TRANSPILER_H
+
+#include <stdio.h>
+#include "token.h"
+
+/**
+ * @brief Translates a resolved program into a C translation unit, to be
+ *        linked against the quokka_runtime library.
+ * @param program The PROGRAM node, after resolve_program()
+ * @param source The name of the source file, for comments and errors
+ * @param out Where the C code is written, nothing is written on failure
+ * @return 0 on success, 1 if the program uses something that cannot be translated
+ */
+int emit_c(ParseNode *program, const char *source, FILE *out);
+
+#endif
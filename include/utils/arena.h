@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct ArenaCleanup ArenaCleanup;
+
+/**
+ * A region that hands out memory by bumping a pointer through large blocks.
+ * Nothing is freed individually, the whole region is released at once by
+ * arena_destroy(), after running the cleanups registered with arena_defer().
+ */
+typedef struct Arena {
+    ArenaBlock *blocks;     // Newest first, allocations come from the head
+    ArenaCleanup *cleanups;
+} Arena;
+
+Arena *arena_create();
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *chars, size_t length);
+void arena_defer(Arena *arena, void (*cleanup)(void *data), void *data);
+void arena_destroy(Arena *arena);
+
+#endif
\ No newline at end of file
@@ -1,31 +1,50 @@
 #ifndef CALL_STACK_H
-#define CALL_STAKC_H
+#define CALL_STACK_H
 
+#include <stdbool.h>
 #include "utils/hash_table.h"
 #include "token.h"
+#include "resolver.h"
 
 typedef struct StackFrame {
     char *caller;
-    HashTable *local_variables;
+    Scope *scope;               // Variables with a slot, NULL if the frame only binds by name
+    Value *slots;               // UNDEFINED_VAL until bound
+    HashTable *local_variables; // Variables without a slot, created on first use
+    Obj *object;                // Object whose fields are the variables, instead of local_variables
     int status;
+    int capacity;               // Slots allocated, kept while the frame is pooled
+    struct StackFrame *next;    // Next free frame in the pool
 } StackFrame;
 
 typedef struct CallStack {
     StackFrame **frames;
     int top;
+    int capacity;
 } CallStack;
 
-StackFrame* frame_create(char *name);
+// The default for the deepest the call stack may grow
+#define DEFAULT_MAX_DEPTH 10000
+
+StackFrame* frame_create(char *name, Scope *scope);
 StackFrame *frame_create_with_variables(char *name, HashTable *table);
-void frame_destroy(StackFrame *frame, int destroy_hashtable);
+StackFrame *frame_create_for_object(char *name, Obj *object);
+void frame_reset(StackFrame *frame, char *name, Scope *scope);
+void frame_destroy(StackFrame *frame, bool destroy_hashtable);
+int frame_get(StackFrame *frame, const char *key, Value *out_value);
+void frame_set(StackFrame *frame, char *key, Value value);
+void frame_set_slot(StackFrame *frame, int slot, Value value);
 
+void stack_set_max_depth(int depth);
 void stack_init(CallStack *stack);
 void stack_push(CallStack *stack, StackFrame *frame);
 StackFrame *stack_pop(CallStack *stack);
 StackFrame *stack_peek(CallStack *stack);
-int stack_get_value(CallStack *stack, const char *key, Value **out_value);
+int stack_get_value(CallStack *stack, const char *key, Value *out_value);
+int stack_lookup(CallStack *stack, Scope *scope, int slot, const char *key, Value *out_value);
+void stack_assign(CallStack *stack, Scope *scope, int slot, char *key, Value value);
 void stack_destroy(CallStack *stack);
 
 void stack_print(CallStack *stack);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,11 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
+#include <stddef.h>
+
 char* read_file(char *name);
+char* map_file(char *name, size_t *mapped_length);
+void unmap_file(char *text, size_t mapped_length);
 int write_file(char *name, char *text);
 
 #endif
\ No newline at end of file
@@ -3,16 +3,15 @@
 
 #include <stddef.h>
 #include "token.h"
-#include "utils/pair.h"
+#include "utils/table.h"
 
 typedef struct HashTable {
-    size_t size;
-    Pair **buckets;
+    Table table;
 } HashTable;
 
 HashTable *hashtable_create(size_t size);
-void hashtable_set(HashTable *table, char *key, Value *value);
-int hashtable_get(HashTable *table, const char *key, Value **out_value);
+void hashtable_set(HashTable *table, char *key, Value value);
+int hashtable_get(HashTable *table, const char *key, Value *out_value);
 void hashtable_destroy(HashTable *table);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * The single copy of a string kept by the intern table. Interned names are
+ * handed out as a pointer to chars, so two names are equal exactly when the
+ * pointers are, and the hash is read back from the header in front of them.
+ */
+typedef struct Symbol {
+    unsigned int hash;
+    int length;
+    char chars[];   // Null terminated
+} Symbol;
+
+#define SYMBOL(name) ((Symbol*)((name) - offsetof(Symbol, chars)))
+#define SYMBOL_HASH(name) (SYMBOL(name)->hash)
+
+unsigned int hash_string(const char *chars, int length);
+
+char *symbol_create(const char *chars, int length);
+void symbol_free(char *name);
+
+char *intern(const char *chars, int length);
+char *intern_string(const char *string);
+char *intern_find(const char *chars, int length);
+void intern_free_all();
+
+#endif
\ No newline at end of file
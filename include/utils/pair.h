@@ -1,12 +0,0 @@
-#ifndef PAIR_H
-#define PAIR_H
-
-#include "token.h"
-
-typedef struct Pair {
-    char *key;
-    Value *value;
-    struct Pair *next;
-} Pair;
-
-#endif
\ No newline at end of file
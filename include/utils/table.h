@@ -0,0 +1,36 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "value.h"
+
+/**
+ * A slot of an open addressed table. An empty slot has a NULL key and a none
+ * value, a deleted one a NULL key and a true value so probing continues past it.
+ */
+typedef struct Entry {
+    const char *key;    // A symbol, interned unless the owner looks keys up by characters
+    Value value;
+} Entry;
+
+/**
+ * Table keyed by interned strings, with linear probing. The capacity is a
+ * power of two, it doubles when more than three quarters full and halves
+ * when under a quarter.
+ */
+typedef struct Table {
+    size_t count;       // Live entries
+    size_t tombstones;  // Deleted entries still occupying a slot
+    size_t capacity;
+    Entry *entries;
+} Table;
+
+void table_init(Table *table, size_t expected);
+void table_free(Table *table);
+bool table_get(Table *table, const char *key, Value *out_value);
+void table_set(Table *table, const char *key, Value value);
+bool table_delete(Table *table, const char *key);
+const char *table_find_key(Table *table, const char *chars, int length);
+
+#endif
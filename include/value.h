@@ -0,0 +1,186 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct HashTable HashTable;
+typedef struct HashMap HashMap;
+typedef struct ParseNode ParseNode;
+typedef struct List List;
+typedef struct Shape Shape;
+
+typedef enum {
+    TYPE_NONE,
+    TYPE_INT,
+    TYPE_FLOAT,
+    TYPE_STRING,
+    TYPE_BOOL,
+    TYPE_LIST,
+    TYPE_MAP,
+    TYPE_FUNCTION,
+    TYPE_CLASS,
+    TYPE_OBJECT,
+    TYPE_NATIVE,
+    TYPE_METADATA
+} ValueType;
+
+/**
+ * A builtin written in C, see builtins.h. It gets every argument of the call,
+ * already evaluated, and returns its result.
+ */
+typedef uint64_t (*NativeFunction)(ParseNode *site, uint64_t *args, int argc);
+
+/**
+ * A value that lives on the heap: strings, lists, maps, functions, builtins,
+ * classes and objects. Parse nodes also use it to hold their literal or name.
+ */
+typedef struct Obj {
+    ValueType type;
+    int references;   // Pins held by things the collector does not scan
+    bool marked;
+    bool interned;    // stringValue belongs to the intern table
+    bool rope;        // String still held as the two halves of a concatenation
+    int length;       // Characters of a string
+    struct Obj *next; // Next object tracked by the collector
+    union {
+        int intValue;
+        double floatValue;
+        char *stringValue;
+        struct {
+            uint64_t left;        // Values of the two halves
+            uint64_t right;
+        } rope;                   // Strings until flattened, see features/rope.h
+        ParseNode *node;          // Functions and classes
+        NativeFunction native;    // Builtins
+        struct {
+            Shape *shape;         // Slot of each field, see features/object.h
+            uint64_t *fields;     // Values in the slots of the shape
+        } object;
+        List *list;
+        HashMap *map;
+    } data;
+} Obj;
+
+/**
+ * Values are NaN-boxed into 64 bits so numbers never touch the heap.
+ * Any double that is not a quiet NaN is a float. Quiet NaNs carry the other
+ * types: with the sign bit set the low 48 bits point to an Obj, otherwise
+ * TAG_INT marks an int in the low 32 bits, TAG_SHORT a string of up to
+ * SHORT_STRING_MAX characters in the low 48 bits, and no tag marks a singleton.
+ */
+typedef uint64_t Value;
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN     ((uint64_t)0x7ffc000000000000)
+#define TAG_INT  ((uint64_t)0x0001000000000000)
+#define TAG_SHORT ((uint64_t)0x0002000000000000)
+#define SHORT_STRING_MAX 6 // Characters that fit in the 48 bit payload
+#define TAG_MASK (SIGN_BIT | QNAN | (uint64_t)0x0003000000000000)
+
+#define NONE_VAL      ((Value)(QNAN | 1))
+#define FALSE_VAL     ((Value)(QNAN | 2))
+#define TRUE_VAL      ((Value)(QNAN | 3))
+#define UNDEFINED_VAL ((Value)(QNAN | 4)) // Marks an unbound variable slot
+
+#define IS_FLOAT(value)     (((value) & QNAN) != QNAN)
+#define IS_INT(value)       (((value) & TAG_MASK) == (QNAN | TAG_INT))
+#define IS_SHORT_STRING(value) (((value) & TAG_MASK) == (QNAN | TAG_SHORT))
+#define IS_BOOL(value)      (((value) | 1) == TRUE_VAL)
+#define IS_NONE(value)      ((value) == NONE_VAL)
+#define IS_UNDEFINED(value) ((value) == UNDEFINED_VAL)
+#define IS_OBJ(value)       (((value) & (SIGN_BIT | QNAN)) == (SIGN_BIT | QNAN))
+
+#define AS_INT(value)    ((int)(uint32_t)(value))
+#define AS_BOOL(value)   ((value) == TRUE_VAL)
+#define AS_FLOAT(value)  value_to_float(value)
+#define AS_OBJ(value)    ((Obj*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+#define AS_STRING(value) string_chars(value, (char[SHORT_STRING_MAX + 1]){0})
+#define AS_LIST(value)   (AS_OBJ(value)->data.list)
+#define AS_MAP(value)    (AS_OBJ(value)->data.map)
+#define AS_FIELDS(value) (AS_OBJ(value)->data.object.fields)
+#define AS_SHAPE(value)  (AS_OBJ(value)->data.object.shape)
+#define AS_NODE(value)   (AS_OBJ(value)->data.node)
+#define AS_NATIVE(value) (AS_OBJ(value)->data.native)
+
+#define INT_VAL(i)     ((Value)(QNAN | TAG_INT | (uint32_t)(i)))
+#define BOOL_VAL(b)    ((b) ? TRUE_VAL : FALSE_VAL)
+#define FLOAT_VAL(f)   float_to_value(f)
+#define OBJ_VAL(obj)   ((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj)))
+
+static inline double value_to_float(Value value) {
+    double f;
+    memcpy(&f, &value, sizeof(double));
+    return f;
+}
+
+static inline Value float_to_value(double f) {
+    Value value;
+    memcpy(&value, &f, sizeof(double));
+    return value;
+}
+
+/**
+ * @brief Get the type of a value, looking through to the heap for objects.
+ * @param value The value.
+ * @return The ValueType of the value, TYPE_NONE for none.
+ */
+static inline ValueType value_type(Value value) {
+    if (IS_FLOAT(value)) return TYPE_FLOAT;
+    if (IS_OBJ(value)) return AS_OBJ(value)->type;
+    if (IS_INT(value)) return TYPE_INT;
+    if (IS_SHORT_STRING(value)) return TYPE_STRING;
+    if (IS_BOOL(value)) return TYPE_BOOL;
+    return TYPE_NONE;
+}
+
+char *rope_flatten(Obj *string);
+
+/**
+ * @brief Make a string value that holds its characters in the value itself.
+ * @param chars The characters, at most SHORT_STRING_MAX of them.
+ * @param length The number of characters.
+ * @return The string value, with the unused bytes zero.
+ */
+static inline Value short_string_val(const char *chars, size_t length) {
+    Value value = QNAN | TAG_SHORT;
+    for (size_t i = 0; i < length; i++) {
+        value |= (Value)(uint8_t)chars[i] << (8 * i);
+    }
+    return value;
+}
+
+static inline size_t short_string_length(Value value) {
+    size_t length = 0;
+    while (length < SHORT_STRING_MAX && ((value >> (8 * length)) & 0xff) != 0) {
+        length++;
+    }
+    return length;
+}
+
+/**
+ * @brief Get the characters of a string. A short string is copied into the
+ *        buffer, and a rope is flattened first.
+ * @param value A string value.
+ * @param buffer Room for SHORT_STRING_MAX characters and the terminator,
+ *        AS_STRING passes one that lives until the end of the caller's block.
+ * @return The null terminated characters.
+ */
+static inline char *string_chars(Value value, char *buffer) {
+    if (IS_SHORT_STRING(value)) {
+        for (int i = 0; i < SHORT_STRING_MAX; i++) {
+            buffer[i] = (char)(value >> (8 * i));
+        }
+        buffer[SHORT_STRING_MAX] = '\0';
+        return buffer;
+    }
+    Obj *string = AS_OBJ(value);
+    return string->rope ? rope_flatten(string) : string->data.stringValue;
+}
+
+Value value_copy(Value old);
+void print_value(Value value);
+void value_destroy(Obj *object);
+
+#endif
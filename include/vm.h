@@ -0,0 +1,17 @@
+#ifndef VM_H
+#define VM_H
+
+#include "token.h"
+#include "bytecode.h"
+#include <stdbool.h>
+
+void set_debug_mode_vm(bool debug);
+
+/**
+ * @brief Executes a compiled program on the bytecode virtual machine
+ * @param chunk The chunk produced by compile()
+ * @return A copy of the value of the last statement, as evaluate() returns
+ */
+Value vm_run(Chunk *chunk);
+
+#endif
@@ -0,0 +1,35 @@
+#include "builtins.h"
+#include "evaluator.h"
+#include "garbage_collector.h"
+#include "features/list.h"
+#include "utils/intern.h"
+
+/**
+ * @brief reserve(list, n): make room for n items in a list, so it grows once
+ *        rather than doubling its way there.
+ * @return The list.
+ */
+static Value builtin_reserve(ParseNode *site, Value *args, int argc) {
+    if (argc < 2 || value_type(args[0]) != TYPE_LIST || !IS_INT(args[1])) {
+        runtime_error(site, "reserve expects a list and an int");
+        return NONE_VAL;
+    }
+    if (AS_INT(args[1]) < 0 || AS_INT(args[1]) > LIST_MAX_RESERVE) {
+        runtime_error(site, "reserve expects between 0 and 16777216 items");
+        return NONE_VAL;
+    }
+
+    list_reserve(AS_LIST(args[0]), AS_INT(args[1]));
+    return args[0];
+}
+
+static void define_native(StackFrame *globals, const char *name, NativeFunction function) {
+    Obj *native = gc_malloc();
+    native->type = TYPE_NATIVE;
+    native->data.native = function;
+    frame_set(globals, intern_string(name), OBJ_VAL(native));
+}
+
+void define_builtins(StackFrame *globals) {
+    define_native(globals, "reserve", builtin_reserve);
+}
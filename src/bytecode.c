@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "garbage_collector.h"
+
+/**
+ * @brief Create an empty chunk of bytecode.
+ * @return A pointer to the chunk.
+ */
+Chunk *chunk_create(void) {
+    Chunk *chunk = calloc(1, sizeof(Chunk));
+    if (!chunk) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return chunk;
+}
+
+/**
+ * @brief Append a byte to the chunk, growing it when full.
+ * @param chunk The chunk to write to.
+ * @param byte The opcode or operand byte.
+ * @param node The node the byte was compiled from.
+ */
+void chunk_write(Chunk *chunk, uint8_t byte, ParseNode *node) {
+    if (chunk->count + 1 > chunk->capacity) {
+        chunk->capacity = chunk->capacity < 8 ? 8 : chunk->capacity * 2;
+        chunk->code = realloc(chunk->code, chunk->capacity * sizeof(uint8_t));
+        chunk->nodes = realloc(chunk->nodes, chunk->capacity * sizeof(ParseNode*));
+        if (!chunk->code || !chunk->nodes) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    chunk->code[chunk->count] = byte;
+    chunk->nodes[chunk->count] = node;
+    chunk->count++;
+}
+
+void chunk_write_operand(Chunk *chunk, uint32_t operand, ParseNode *node) {
+    uint8_t bytes[sizeof(uint32_t)];
+    memcpy(bytes, &operand, sizeof(uint32_t));
+    for (size_t i = 0; i < sizeof(uint32_t); i++) {
+        chunk_write(chunk, bytes[i], node);
+    }
+}
+
+/**
+ * @brief Overwrite an operand that has already been written, used for forward jumps.
+ * @param chunk The chunk to patch.
+ * @param offset The offset of the first byte of the operand.
+ * @param operand The new operand.
+ */
+void chunk_patch_operand(Chunk *chunk, int offset, uint32_t operand) {
+    memcpy(&chunk->code[offset], &operand, sizeof(uint32_t));
+}
+
+/**
+ * @brief Add a value to the constant pool. The chunk pins the value so the
+ *        collector keeps it for as long as the chunk exists.
+ * @param chunk The chunk owning the pool.
+ * @param value The constant value.
+ * @return The index of the constant.
+ */
+int chunk_add_constant(Chunk *chunk, Value value) {
+    if (chunk->constant_count + 1 > chunk->constant_capacity) {
+        chunk->constant_capacity = chunk->constant_capacity < 8 ? 8 : chunk->constant_capacity * 2;
+        chunk->constants = realloc(chunk->constants, chunk->constant_capacity * sizeof(Value));
+        if (!chunk->constants) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    gc_reference(value);
+    chunk->constants[chunk->constant_count] = value;
+    return chunk->constant_count++;
+}
+
+/**
+ * @brief Free a chunk and unpin its constant pool, leaving the constants to the collector.
+ * @param chunk The chunk to destroy.
+ */
+void chunk_destroy(Chunk *chunk) {
+    if (!chunk) return;
+    for (int i = 0; i < chunk->constant_count; i++) {
+        gc_dereference(chunk->constants[i]);
+    }
+    free(chunk->constants);
+    free(chunk->code);
+    free(chunk->nodes);
+    free(chunk);
+}
+
+static const char *opcode_name(OpCode op) {
+    switch (op) {
+        case BC_CONSTANT: return "CONSTANT";
+        case BC_NONE: return "NONE";
+        case BC_POP: return "POP";
+        case BC_LOAD_LOCAL: return "LOAD_LOCAL";
+        case BC_LOAD_GLOBAL: return "LOAD_GLOBAL";
+        case BC_LOAD_NAME: return "LOAD_NAME";
+        case BC_GET_LOCAL: return "GET_LOCAL";
+        case BC_GET_GLOBAL: return "GET_GLOBAL";
+        case BC_GET_NAME: return "GET_NAME";
+        case BC_SET_LOCAL: return "SET_LOCAL";
+        case BC_SET_NAME: return "SET_NAME";
+        case BC_SET_FIELD: return "SET_FIELD";
+        case BC_JUMP_IF_NOT_CALLABLE: return "JUMP_IF_NOT_CALLABLE";
+        case BC_CALL: return "CALL";
+        case BC_MEMBER: return "MEMBER";
+        case BC_CALL_METHOD: return "CALL_METHOD";
+        case BC_TAIL_CALL: return "TAIL_CALL";
+        case BC_ADD: return "ADD";
+        case BC_SUB: return "SUB";
+        case BC_MUL: return "MUL";
+        case BC_DIV: return "DIV";
+        case BC_MOD: return "MOD";
+        case BC_GT: return "GT";
+        case BC_GTE: return "GTE";
+        case BC_LT: return "LT";
+        case BC_LTE: return "LTE";
+        case BC_EQ: return "EQ";
+        case BC_NEQ: return "NEQ";
+        case BC_NOT: return "NOT";
+        case BC_LIST: return "LIST";
+        case BC_MAP: return "MAP";
+        case BC_INDEX: return "INDEX";
+        case BC_SET_INDEX: return "SET_INDEX";
+        case BC_JUMP: return "JUMP";
+        case BC_JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+        case BC_LOOP: return "LOOP";
+        case BC_OUT: return "OUT";
+        case BC_IN: return "IN";
+        case BC_IMPORT: return "IMPORT";
+        case BC_RETURN: return "RETURN";
+        default: return "?";
+    }
+}
+
+static int operand_count(OpCode op) {
+    switch (op) {
+        case BC_CONSTANT: case BC_LOAD_LOCAL: case BC_LOAD_GLOBAL: case BC_LOAD_NAME:
+        case BC_GET_LOCAL: case BC_GET_GLOBAL: case BC_GET_NAME: case BC_SET_LOCAL:
+        case BC_SET_NAME: case BC_SET_FIELD: case BC_JUMP_IF_NOT_CALLABLE:
+        case BC_CALL: case BC_CALL_METHOD: case BC_TAIL_CALL: case BC_LIST: case BC_MAP:
+        case BC_JUMP: case BC_JUMP_IF_FALSE: case BC_LOOP:
+            return 1;
+        case BC_MEMBER:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Print a human readable listing of a chunk, used by --debug.
+ * @param chunk The chunk to print.
+ * @param name A label for the listing.
+ */
+void disassemble_chunk(Chunk *chunk, const char *name) {
+    printf("== %s ==\n", name);
+    int offset = 0;
+    while (offset < chunk->count) {
+        OpCode op = chunk->code[offset];
+        printf("%04d %-22s", offset, opcode_name(op));
+
+        int operands = operand_count(op);
+        for (int i = 0; i < operands; i++) {
+            printf(" %u", chunk_read_operand(&chunk->code[offset + 1 + i * sizeof(uint32_t)]));
+        }
+        if (op == BC_CONSTANT || op == BC_LOAD_NAME || op == BC_GET_NAME ||
+            op == BC_SET_NAME || op == BC_SET_FIELD || op == BC_MEMBER) {
+            printf(" (");
+            print_value(chunk->constants[chunk_read_operand(&chunk->code[offset + 1])]);
+            printf(")");
+        } else if (op == BC_LOAD_LOCAL || op == BC_LOAD_GLOBAL || op == BC_GET_LOCAL ||
+                   op == BC_GET_GLOBAL || op == BC_SET_LOCAL) {
+            printf(" (%s)", node_name(chunk->nodes[offset]));
+        }
+        printf("\n");
+
+        offset += 1 + operands * sizeof(uint32_t);
+    }
+}
@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "token.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "resolver.h"
+#include "evaluator.h"
+#include "garbage_collector.h"
+#include "utils/intern.h"
+
+static void compile_node(ParseNode *node);
+
+Chunk *current_chunk;
+
+static void emit(OpCode op, ParseNode *node) {
+    chunk_write(current_chunk, op, node);
+}
+
+static void emit_with_operand(OpCode op, uint32_t operand, ParseNode *node) {
+    chunk_write(current_chunk, op, node);
+    chunk_write_operand(current_chunk, operand, node);
+}
+
+static uint32_t make_constant(Value value) {
+    return chunk_add_constant(current_chunk, value);
+}
+
+static uint32_t make_name(ParseNode *identifier) {
+    Obj *name = gc_malloc();
+    name->type = TYPE_STRING;
+    name->data.stringValue = node_name(identifier);
+    name->length = SYMBOL(node_name(identifier))->length;
+    name->interned = true;
+    return make_constant(OBJ_VAL(name));
+}
+
+/**
+ * @brief Emit a forward jump with a placeholder offset.
+ * @return The offset of the operand to patch once the target is known.
+ */
+static int emit_jump(OpCode op, ParseNode *node) {
+    emit_with_operand(op, 0, node);
+    return current_chunk->count - sizeof(uint32_t);
+}
+
+static void patch_jump(int operand_offset) {
+    uint32_t jump = current_chunk->count - (operand_offset + sizeof(uint32_t));
+    chunk_patch_operand(current_chunk, operand_offset, jump);
+}
+
+static void emit_loop(int loop_start, ParseNode *node) {
+    uint32_t jump = current_chunk->count + 1 + sizeof(uint32_t) - loop_start;
+    emit_with_operand(BC_LOOP, jump, node);
+}
+
+/**
+ * @brief Compile the statements of a PROGRAM or STATEMENT_LIST node, leaving
+ *        the value of the last statement on the stack.
+ */
+static void compile_statement_list(ParseNode *node) {
+    for (int i = 0; i < node->item_count; i++) {
+        if (i > 0) emit(BC_POP, node_item(node, i));
+        compile_node(node_item(node, i));
+    }
+    if (node->item_count == 0) emit(BC_NONE, node);
+}
+
+/**
+ * @brief Compile every item of a node, returning how many were pushed.
+ *        Used for arguments and list elements.
+ */
+static uint32_t compile_items(ParseNode *node) {
+    for (int i = 0; i < node->item_count; i++) {
+        compile_node(node_item(node, i));
+    }
+    return node->item_count;
+}
+
+/**
+ * @brief Emit a variable access through the slot given by the resolver, if any.
+ * @param identifier The IDENTIFIER node, also used for the name on a slow lookup.
+ */
+static void emit_variable(ParseNode *identifier, OpCode local, OpCode global, OpCode named) {
+    if (identifier->slot < 0) {
+        emit_with_operand(named, make_name(identifier), identifier);
+    } else if (node_scope(identifier) == current_chunk->scope) {
+        emit_with_operand(local, identifier->slot, identifier);
+    } else {
+        emit_with_operand(global, identifier->slot, identifier);
+    }
+}
+
+static void compile_identifier(ParseNode *node) {
+    if (node->item_count == 0) {
+        emit_variable(node, BC_LOAD_LOCAL, BC_LOAD_GLOBAL, BC_LOAD_NAME);
+        return;
+    }
+
+    // Arguments are only evaluated when the identifier turns out to be callable
+    emit_variable(node, BC_GET_LOCAL, BC_GET_GLOBAL, BC_GET_NAME);
+    int skip_args = emit_jump(BC_JUMP_IF_NOT_CALLABLE, node);
+    uint32_t argc = compile_items(node);
+    emit_with_operand(BC_CALL, argc, node);
+    patch_jump(skip_args);
+}
+
+/**
+ * @brief Compile the call a function returns. The frames of a function no
+ *        other frame reads by name can be reused by the callee, as nothing
+ *        runs in them once the call is made.
+ */
+static void compile_return(ParseNode *node) {
+    ParseNode *call = node_left(node);
+    if (call == NULL || call->type != IDENTIFIER || current_chunk->scope == NULL
+        || !current_chunk->scope->private) {
+        compile_node(call);
+        emit(BC_RETURN, node);
+        return;
+    }
+
+    emit_variable(call, BC_GET_LOCAL, BC_GET_GLOBAL, BC_GET_NAME);
+    int skip_args = emit_jump(BC_JUMP_IF_NOT_CALLABLE, call);
+    uint32_t argc = compile_items(call);
+    emit_with_operand(BC_TAIL_CALL, argc, call);
+    patch_jump(skip_args);
+    emit(BC_RETURN, node);
+}
+
+static void compile_assignment(ParseNode *node) {
+    if (node_left(node) == NULL) {
+        fprintf(stderr, "\nCompile Error: Invalid assignment target on line %d.\n", node->line);
+        emit(BC_NONE, node);
+        return;
+    }
+
+    switch (node_left(node)->type) {
+        case IDENTIFIER:
+            compile_node(node_right(node));
+            emit_variable(node_left(node), BC_SET_LOCAL, BC_SET_NAME, BC_SET_NAME);
+            break;
+        case OP_INDEX:
+            compile_node(node_left(node_left(node)));
+            compile_node(node_right(node_left(node)));
+            compile_node(node_right(node));
+            emit(BC_SET_INDEX, node);
+            break;
+        default:
+            fprintf(stderr, "\nCompile Error: Invalid assignment target on line %d.\n", node->line);
+            emit(BC_NONE, node);
+            break;
+    }
+}
+
+static void compile_definition(ParseNode *node, ValueType type) {
+    Value value;
+    if (type == TYPE_CLASS) {
+        value = create_class(node);
+    } else {
+        Obj *definition = gc_malloc();
+        definition->type = type;
+        definition->data.node = node;
+        value = OBJ_VAL(definition);
+    }
+    emit_with_operand(BC_CONSTANT, make_constant(value), node);
+    emit_variable(node_left(node), BC_SET_LOCAL, BC_SET_NAME, BC_SET_NAME);
+}
+
+static void compile_member(ParseNode *node) {
+    compile_node(node_left(node));
+
+    ParseNode *member = node_right(node);
+    chunk_write(current_chunk, BC_MEMBER, node);
+    chunk_write_operand(current_chunk, make_name(member), node);
+    chunk_write_operand(current_chunk, 0, node);
+    int skip_call = current_chunk->count - sizeof(uint32_t);
+
+    uint32_t argc = compile_items(member);
+    emit_with_operand(BC_CALL_METHOD, argc, member);
+    patch_jump(skip_call);
+}
+
+static void compile_while(ParseNode *node) {
+    emit(BC_NONE, node);
+
+    int loop_start = current_chunk->count;
+    compile_node(node_left(node));
+    int exit_jump = emit_jump(BC_JUMP_IF_FALSE, node);
+
+    emit(BC_POP, node);
+    compile_node(node_right(node));
+    emit_loop(loop_start, node);
+
+    patch_jump(exit_jump);
+}
+
+static void compile_for(ParseNode *node) {
+    ParseNode *control = node_left(node);
+    compile_node(node_left(control));
+    emit(BC_POP, node);
+    emit(BC_NONE, node);
+
+    int loop_start = current_chunk->count;
+    compile_node(node_left(node_right(control)));
+    int exit_jump = emit_jump(BC_JUMP_IF_FALSE, node);
+
+    emit(BC_POP, node);
+    compile_node(node_right(node));
+    compile_node(node_right(node_right(control)));
+    emit(BC_POP, node);
+    emit_loop(loop_start, node);
+
+    patch_jump(exit_jump);
+}
+
+static void compile_if(ParseNode *node) {
+    compile_node(node_left(node));
+    int else_jump = emit_jump(BC_JUMP_IF_FALSE, node);
+
+    compile_node(node_left(node_right(node)));
+    int end_jump = emit_jump(BC_JUMP, node);
+
+    patch_jump(else_jump);
+    if (node_right(node_right(node)) != NULL) {
+        compile_node(node_right(node_right(node)));
+    } else {
+        emit(BC_NONE, node);
+    }
+    patch_jump(end_jump);
+}
+
+/**
+ * @brief Compile && and || as jumps, so the right operand only runs when the
+ *        left one does not decide the result. Leaves true or false.
+ */
+static void compile_logical(ParseNode *node) {
+    compile_node(node_left(node));
+    int right_jump = emit_jump(BC_JUMP_IF_FALSE, node);
+
+    if (node->type == OP_AND) {
+        compile_node(node_right(node));
+        emit(BC_NOT, node);
+        emit(BC_NOT, node);
+        int end_jump = emit_jump(BC_JUMP, node);
+        patch_jump(right_jump);
+        emit_with_operand(BC_CONSTANT, make_constant(FALSE_VAL), node);
+        patch_jump(end_jump);
+    } else {
+        emit_with_operand(BC_CONSTANT, make_constant(TRUE_VAL), node);
+        int end_jump = emit_jump(BC_JUMP, node);
+        patch_jump(right_jump);
+        compile_node(node_right(node));
+        emit(BC_NOT, node);
+        emit(BC_NOT, node);
+        patch_jump(end_jump);
+    }
+}
+
+static void compile_map(ParseNode *node) {
+    for (int i = 0; i < node->item_count; i++) {
+        compile_node(node_left(node_item(node, i)));
+        compile_node(node_right(node_item(node, i)));
+    }
+    emit_with_operand(BC_MAP, node->item_count, node);
+}
+
+static void compile_binary(ParseNode *node, OpCode op) {
+    compile_node(node_left(node));
+    compile_node(node_right(node));
+    emit(op, node);
+}
+
+static void compile_node(ParseNode *node) {
+    if (node == NULL) {
+        emit(BC_NONE, node);
+        return;
+    }
+
+    switch (node->type) {
+        case PROGRAM: case STATEMENT_LIST: compile_statement_list(node); break;
+        case IMPORT: emit(BC_IMPORT, node); break;
+        case ASSIGNMENT: compile_assignment(node); break;
+        case SET:
+            compile_node(node_right(node));
+            emit_with_operand(BC_SET_FIELD, make_name(node_left(node)), node);
+            break;
+        case CLASS: compile_definition(node, TYPE_CLASS); break;
+        case FUNCTION: compile_definition(node, TYPE_FUNCTION); break;
+        case MAP: compile_map(node); break;
+        case LIST: emit_with_operand(BC_LIST, compile_items(node), node); break;
+        case IDENTIFIER: compile_identifier(node); break;
+        case WHILE: compile_while(node); break;
+        case FOR: compile_for(node); break;
+        case LITERAL:
+            emit_with_operand(BC_CONSTANT, make_constant(node_literal(node)), node);
+            break;
+        case OUT:
+            compile_node(node_left(node));
+            emit(BC_OUT, node);
+            break;
+        case IN: emit(BC_IN, node); break;
+        case RETURN: compile_return(node); break;
+        case OP_DOT: compile_member(node); break;
+        case OP_INDEX: compile_binary(node, BC_INDEX); break;
+        case OP_ADD: compile_binary(node, BC_ADD); break;
+        case OP_SUB: compile_binary(node, BC_SUB); break;
+        case OP_MUL: compile_binary(node, BC_MUL); break;
+        case OP_DIV: compile_binary(node, BC_DIV); break;
+        case OP_MOD: compile_binary(node, BC_MOD); break;
+        case OP_GT: compile_binary(node, BC_GT); break;
+        case OP_GTE: compile_binary(node, BC_GTE); break;
+        case OP_LT: compile_binary(node, BC_LT); break;
+        case OP_LTE: compile_binary(node, BC_LTE); break;
+        case OP_EQ: compile_binary(node, BC_EQ); break;
+        case OP_NEQ: compile_binary(node, BC_NEQ); break;
+        case OP_AND: case OP_OR: compile_logical(node); break;
+        case OP_NOT:
+            compile_node(node_left(node));
+            emit(BC_NOT, node);
+            break;
+        case TERN_IF:
+        case IF:
+            compile_if(node);
+            break;
+        default:
+            fprintf(stderr, "Error compiling Node\nType: %d\nString Value: %s\n", node->type, node_name(node));
+            emit(BC_NONE, node);
+            break;
+    }
+}
+
+/**
+ * @brief Compile the statements a class runs for each new object. Its methods
+ *        are left out, as the class value already holds them.
+ */
+static void compile_class_body(ParseNode *body) {
+    if (body->type != STATEMENT_LIST) {
+        if (body->type == FUNCTION) {
+            emit(BC_NONE, body);
+        } else {
+            compile_node(body);
+        }
+        return;
+    }
+
+    int compiled = 0;
+    for (int i = 0; i < body->item_count; i++) {
+        if (node_item(body, i)->type == FUNCTION) continue;
+        if (compiled++ > 0) emit(BC_POP, node_item(body, i));
+        compile_node(node_item(body, i));
+    }
+    if (compiled == 0) emit(BC_NONE, body);
+}
+
+static Chunk *compile_chunk(ParseNode *node, Scope *scope, void (*compile_code)(ParseNode *node)) {
+    Chunk *enclosing = current_chunk;
+    Chunk *chunk = chunk_create();
+    chunk->scope = scope;
+    current_chunk = chunk;
+
+    compile_code(node);
+    emit(BC_RETURN, node);
+
+    current_chunk = enclosing;
+    return chunk;
+}
+
+/**
+ * @brief Lowers an AST produced by parse() into a chunk of bytecode
+ * @param node The root node of the AST
+ * @return The compiled chunk, owned by the caller
+ */
+Chunk *compile(ParseNode *node) {
+    return compile_chunk(node, node_scope(node), compile_node);
+}
+
+/**
+ * @brief Compiles the body of a function or class definition on first use
+ *        and caches the chunk on the definition node
+ * @param definition A FUNCTION or CLASS node
+ * @return The compiled body, owned by the node
+ */
+Chunk *compile_body(ParseNode *definition) {
+    if (node_code(definition) == NULL) {
+        node_set_code(definition, definition->type == CLASS
+            ? compile_chunk(node_right(definition), NULL, compile_class_body)
+            : compile_chunk(node_right(definition), node_scope(definition), compile_node));
+    }
+    return node_code(definition);
+}
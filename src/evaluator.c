@@ -5,67 +5,102 @@
 #include "utils/hash_table.h"
 #include "utils/call_stack.h"
 #include "utils/file_utils.h"
+#include "utils/intern.h"
+#include "utils/arena.h"
 #include "features/list.h"
 #include "features/hashmap.h"
+#include "features/rope.h"
+#include "features/object.h"
 #include "evaluator.h"
 #include "lexer.h"
 #include "parser.h"
 #include "garbage_collector.h"
+#include "resolver.h"
+#include "optimiser.h"
+#include "jit.h"
+#include "builtins.h"
 
 #define MAX_STRING_LENGTH 128
 
-Value *evaluate_program(ParseNode *node);
-Value *evaluate_statement_list(ParseNode *node);
-Value *evaluate_import(ParseNode *node);
-Value *evaluate_assignment(ParseNode *node);
-Value *evaluate_set(ParseNode *node);
-Value *evaluate_class(ParseNode *node);
-Value *evaluate_function(ParseNode *node);
-Value *evaluate_list(ParseNode *node);
-Value *evaluate_map(ParseNode *node);
-Value *evaluate_identifier(ParseNode *node);
-Value *evaluate_while(ParseNode *node);
-Value *evaluate_for(ParseNode *node);
-Value *evaluate_literal(ParseNode *node);
-Value *evaluate_op_add(ParseNode *node);
-Value *evaluate_op_binary(ParseNode *node);
-Value *evaluate_op_eq(ParseNode *node);
-Value *evaluate_op_neq(ParseNode *node);
-Value *evaluate_op_not(ParseNode *node);
-Value *evaluate_op_index(ParseNode *node);
-Value *evaluate_if(ParseNode *node);
-Value *evaluate_out(ParseNode *node);
-Value *evaluate_in(ParseNode *node);
-Value *evaluate_return(ParseNode *node);
-
-void runtime_error(ParseNode *node,char* string);
-void cleanup();
-void error_and_exit(ParseNode *node,char* string);
+Value evaluate_program(ParseNode *node);
+Value evaluate_statement_list(ParseNode *node);
+Value evaluate_import(ParseNode *node);
+Value evaluate_assignment(ParseNode *node);
+Value evaluate_set(ParseNode *node);
+Value evaluate_class(ParseNode *node);
+Value evaluate_function(ParseNode *node);
+Value evaluate_list(ParseNode *node);
+Value evaluate_map(ParseNode *node);
+Value evaluate_identifier(ParseNode *node);
+Value evaluate_while(ParseNode *node);
+Value evaluate_for(ParseNode *node);
+Value evaluate_literal(ParseNode *node);
+Value evaluate_op_add(ParseNode *node);
+Value evaluate_op_binary(ParseNode *node);
+Value evaluate_op_logical(ParseNode *node);
+Value evaluate_quickened(ParseNode *node);
+static void quicken(ParseNode *node, Value left, Value right);
+Value evaluate_op_eq(ParseNode *node);
+Value evaluate_op_neq(ParseNode *node);
+Value evaluate_op_not(ParseNode *node);
+Value evaluate_op_index(ParseNode *node);
+Value evaluate_if(ParseNode *node);
+Value evaluate_out(ParseNode *node);
+Value evaluate_in(ParseNode *node);
+Value evaluate_return(ParseNode *node);
 
 CallStack *callStack = NULL;
 bool debug_mode = false;
 int evaluate_depth = 0;
 
+// A call in tail position waiting for the function below to take it over
+static struct {
+    ParseNode *site;        // The identifier of the call, NULL when none is waiting
+    ParseNode *definition;
+    Value *args;            // The bound arguments, a root array of the GC
+    int argc;
+    int capacity;
+} tail_call = { NULL, NULL, NULL, 0, 0 };
+
+// Arguments of a tail call gathered on the native stack, more are allocated
+#define TAIL_CALL_LOCAL_ARGS 8
+
+// The arena of each imported file, in the order they were loaded
+Arena **import_arenas = NULL;
+int import_count = 0;
+
 void set_debug_mode_evaluator(bool debug) {
     debug_mode = debug;
 }
 
 /**
- * @brief Evaluates a given AST to a return value
- * @param node The root node of the AST
- * @return The evaluated value
+ * @brief Creates the call stack with the main frame if it does not exist yet
  */
-Value *evaluate(ParseNode *node) {
+void init_call_stack(Scope *globals) {
     if (callStack == NULL) {
         callStack = malloc(sizeof(CallStack));
         stack_init(callStack);
 
-        StackFrame* main = frame_create("main");
+        StackFrame* main = frame_create("main", globals);
         stack_push(callStack, main);
+        define_builtins(main);
+
+        // The arguments of a waiting tail call are live until the frame is
+        // rebound, after any number of loops and statement lists have unwound
+        gc_add_roots(&tail_call.args, &tail_call.argc);
     }
+}
+
+/**
+ * @brief Evaluates a given AST to a return value
+ * @param node The root node of the AST
+ * @return The evaluated value
+ */
+Value evaluate(ParseNode *node) {
     if (node == NULL) {
-        return NULL;
+        return NONE_VAL;
     }
+    init_call_stack(node_scope(node)); // The root is the program, which owns the global scope
 
     switch (node->type) {
         case PROGRAM: return evaluate_program(node);
@@ -85,7 +120,7 @@ Value *evaluate(ParseNode *node) {
         case IN: return evaluate_in(node);
         case RETURN: return evaluate_return(node);
         case OP_EQ: return evaluate_op_eq(node);
-        case OP_NEQ: return evaluate_op_eq(node);
+        case OP_NEQ: return evaluate_op_neq(node);
         case OP_DOT: return call_object(node);
         case OP_ADD: return evaluate_op_add(node);
         case OP_INDEX: return evaluate_op_index(node);
@@ -97,225 +132,376 @@ Value *evaluate(ParseNode *node) {
         case OP_GTE:
         case OP_LT:
         case OP_LTE:
+            return evaluate_op_binary(node);
         case OP_AND:
         case OP_OR:
-            return evaluate_op_binary(node);
+            return evaluate_op_logical(node);
         case OP_NOT: return evaluate_op_not(node);
+        case OP_ADD_INT: case OP_SUB_INT: case OP_MUL_INT: case OP_DIV_INT: case OP_MOD_INT:
+        case OP_GT_INT: case OP_GTE_INT: case OP_LT_INT: case OP_LTE_INT:
+        case OP_EQ_INT: case OP_NEQ_INT:
+        case OP_ADD_FLOAT: case OP_SUB_FLOAT: case OP_MUL_FLOAT: case OP_DIV_FLOAT:
+        case OP_GT_FLOAT: case OP_GTE_FLOAT: case OP_LT_FLOAT: case OP_LTE_FLOAT:
+            return evaluate_quickened(node);
         case TERN_IF:
         case IF:
             return evaluate_if(node);
         default:
-            fprintf(stderr, "Error evaluating Node\nType: %d\nString Value: %s\n", node->type, node->value.data.stringValue);
-            return NULL;
+            fprintf(stderr, "Error evaluating Node\nType: %d\nString Value: %s\n", node->type, node_name(node));
+            return NONE_VAL;
     }
 }
 
-Value *evaluate_program(ParseNode *node) {
-    Value *evaluated = evaluate(node->right);
-    if (evaluated == NULL) {
-        return NULL;
+Value evaluate_program(ParseNode *node) {
+    Value evaluated = evaluate_statement_list(node);
+    if (IS_NONE(evaluated)) {
+        return NONE_VAL;
     }
 
-    Value *program_return = value_copy(evaluated);
+    Value program_return = value_copy(evaluated);
     cleanup();
     return program_return;
 }
 
-Value *evaluate_statement_list(ParseNode *node) {
-    // Automatically make last statement the return value.
-    if (node->right == NULL) {
-        return evaluate(node->left);
-    } else {
-        if (node->left != NULL) {
-            Value *value = evaluate(node->left);
+Value evaluate_statement_list(ParseNode *node) {
+    if (node->item_count == 0) {
+        return NONE_VAL;
+    }
+
+    // A return leaves every statement list and loop up to its call, so the
+    // frame stays marked until the call ends
+    for (int i = 0; i < node->item_count - 1; i++) {
+        Value value = evaluate(node_item(node, i));
 
-            if (stack_peek(callStack)->status == 1) {
-                stack_peek(callStack)->status = 0;
-                return value;
-            }
+        if (stack_peek(callStack)->status == 1) {
+            return value;
         }
-        return evaluate(node->right);
     }
+
+    // Automatically make last statement the return value.
+    return evaluate(node_item(node, node->item_count - 1));
+}
+
+Value evaluate_import(ParseNode *node) {
+    // A return in the imported file only ends the import, as in the VM
+    Value value = evaluate_statement_list(load_import(node));
+    stack_peek(callStack)->status = 0;
+    return value;
 }
 
-Value *evaluate_import(ParseNode *node) {
+ParseNode *load_import(ParseNode *node) {
     // Replace the import node with the AST of the imported file
-    char *input = read_file(node->left->value.data.stringValue);
+    if (node_left(node) == NULL || value_type(node_literal(node_left(node))) != TYPE_STRING) {
+        error_and_exit(node, "Invalid import statement");
+    }
+    size_t mapped_length;
+    char *input = map_file(AS_STRING(node_literal(node_left(node))), &mapped_length);
     if (!input) {
         error_and_exit(node, "Invalid import statement");
     }
 
-    int token_count = 1024; // TODO: look at linking to given count in main file
+    int token_count;
     Token *tokens = tokenize(input, &token_count);
     if (!tokens) {
         error_and_exit(node, "Failed to tokenize imported file");
     }
 
-    ParseNode *ast = parse(tokens, token_count);
+    // Each imported file is parsed into an arena of its own
+    Arena *arena = arena_create();
+    import_arenas = realloc(import_arenas, (import_count + 1) * sizeof(Arena*));
+    if (!import_arenas) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    import_arenas[import_count++] = arena;
+
+    ParseNode *ast = parse(tokens, token_count, arena);
     if (!ast) {
         error_and_exit(node, "Failed to parse imported file");
     }
+    free_tokens(tokens, token_count);
+    unmap_file(input, mapped_length);
+    optimise_program(ast, arena);
+    resolve_import(ast, callStack->frames[0]->scope);
 
-    // Add to the tree for easier cleanup
-    node->left = ast;
+    node_set_left(node, ast);
+    return ast;
+}
 
-    evaluate_statement_list(ast);
+/**
+ * @brief Free the syntax trees of every imported file. Must be called after
+ *        the arena of the main file is destroyed, as chunks compiled for its
+ *        import nodes point into the imported trees.
+ */
+void free_imports() {
+    for (int i = 0; i < import_count; i++) {
+        arena_destroy(import_arenas[i]);
+    }
+    free(import_arenas);
+    import_arenas = NULL;
+    import_count = 0;
 }
 
-Value *evaluate_assignment(ParseNode *node) {
-    if (!node->left) {
+/**
+ * @brief Bind a value to an identifier in the current frame, using the slot
+ *        given by the resolver when it has one.
+ */
+void assign_variable(ParseNode *identifier, Value value) {
+    stack_assign(callStack, node_scope(identifier), identifier->slot, node_name(identifier), value);
+}
+
+Value evaluate_assignment(ParseNode *node) {
+    if (!node_left(node)) {
         runtime_error(node, "Invalid assignment target");
-        return NULL;
+        return NONE_VAL;
     }
 
-    Value *value;
+    Value value;
 
-    switch (node->left->type)
+    switch (node_left(node)->type)
     {
     case IDENTIFIER:
-        value = evaluate(node->right);
-        hashtable_set(stack_peek(callStack)->local_variables, node->left->value.data.stringValue, value);
+        value = evaluate(node_right(node));
+        assign_variable(node_left(node), value);
         return value;
 
     case OP_INDEX:
-        Value *container = evaluate(node->left->left);
-        Value *index = evaluate(node->left->right);
-        value = evaluate(node->right);
-        if (container->type == TYPE_LIST) {
-            list_edit(container->data.list, index->data.intValue, value);
-        } else if (container->type == TYPE_MAP) {
-            hashmap_set(container->data.map, index->data.stringValue, value);
-        } else {
-            runtime_error(node, "Invalid assignment target");
-            return NULL;
-        }
-        return value;
+        Value container = evaluate(node_left(node_left(node)));
+        gc_push_root(container);
+        Value index = evaluate(node_right(node_left(node)));
+        gc_push_root(index);
+        value = evaluate(node_right(node));
+        gc_pop_roots(2);
+        return apply_index_assignment(node, container, index, value);
     
     default:
         runtime_error(node, "Invalid assignment target");
-        return NULL;
+        return NONE_VAL;
     }
 }
 
-Value *evaluate_set(ParseNode *node) {
-    Value *rhs = evaluate(node->right);
+Value apply_index_assignment(ParseNode *node, Value container, Value index, Value value) {
+    if (value_type(container) == TYPE_LIST) {
+        if (!IS_INT(index)) {
+            runtime_error(node, "List index must be int");
+            return NONE_VAL;
+        }
+        list_edit(AS_LIST(container), AS_INT(index), value);
+    } else if (value_type(container) == TYPE_MAP) {
+        if (value_type(index) != TYPE_STRING) {
+            runtime_error(node, "Map index must be a string");
+            return NONE_VAL;
+        }
+        hashmap_set(AS_MAP(container), AS_STRING(index), value);
+    } else {
+        runtime_error(node, "Invalid assignment target");
+        return NONE_VAL;
+    }
+    return value;
+}
+
+Value evaluate_set(ParseNode *node) {
+    return apply_set(node, evaluate(node_right(node)));
+}
 
+Value apply_set(ParseNode *node, Value rhs) {
     // Get the object
-    Value *object;
-    int found_object = stack_get_value(callStack, "self", &object);
+    Value object;
+    int found_object = stack_get_value(callStack, intern_string("self"), &object);
     if (found_object == 0) {
         error_and_exit(node, "Set used but no class to reference");
     }
 
-    hashtable_set(object->data.object_fields, node->left->value.data.stringValue, rhs);
+    object_set_field(AS_OBJ(object), node_name(node_left(node)), rhs);
     return rhs;
 }
 
-Value *evaluate_class(ParseNode *node) {
-    Value *class_value = gc_malloc();
-    class_value->type = TYPE_CLASS;
-    class_value->data.node = node;
-
-    hashtable_set(stack_peek(callStack)->local_variables, node->left->value.data.stringValue, class_value);
+Value evaluate_class(ParseNode *node) {
+    Value class_value = create_class(node);
+    assign_variable(node_left(node), class_value);
     return class_value;
 }
 
-Value *evaluate_function(ParseNode *node) {
-    Value *func_value = gc_malloc();
-    func_value->type = TYPE_FUNCTION;
-    func_value->data.node = node;
-    hashtable_set(stack_peek(callStack)->local_variables,
-                node->left->value.data.stringValue,
-                func_value);
+/**
+ * @brief Whether a statement of a class body defines a method, which the class
+ *        holds instead of each object.
+ */
+static bool is_method(ParseNode *statement) {
+    return statement->type == FUNCTION;
+}
+
+/**
+ * @brief Create a class. The first time a CLASS node runs, it is given its
+ *        root shape, with a function value for each method defined directly
+ *        in its body. The methods are shared by every instance and pinned,
+ *        as they live as long as the node.
+ * @param node The CLASS node.
+ * @return The class value, not yet bound to its name.
+ */
+Value create_class(ParseNode *node) {
+    if (node_shape(node) == NULL) {
+        HashTable *methods = hashtable_create(0);
+
+        ParseNode *body = node_right(node);
+        bool list = body->type == STATEMENT_LIST;
+        int count = list ? body->item_count : 1;
+        for (int i = 0; i < count; i++) {
+            ParseNode *statement = list ? node_item(body, i) : body;
+            if (!is_method(statement)) continue;
+
+            Obj *method = gc_malloc();
+            method->type = TYPE_FUNCTION;
+            method->data.node = statement;
+            gc_reference(OBJ_VAL(method));
+            hashtable_set(methods, node_name(node_left(statement)), OBJ_VAL(method));
+        }
+        node_set_shape(node, shape_create(methods));
+    }
+
+    Obj *class = gc_malloc();
+    class->type = TYPE_CLASS;
+    class->data.node = node;
+    return OBJ_VAL(class);
+}
+
+/**
+ * @brief Run the statements of a class body that initialise the fields of a
+ *        new object, skipping its methods.
+ */
+static void evaluate_class_body(ParseNode *body) {
+    if (body->type != STATEMENT_LIST) {
+        if (!is_method(body)) evaluate(body);
+        return;
+    }
+
+    for (int i = 0; i < body->item_count; i++) {
+        if (is_method(node_item(body, i))) continue;
+        evaluate(node_item(body, i));
+
+        if (stack_peek(callStack)->status == 1) {
+            stack_peek(callStack)->status = 0;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Push the frames a method or class body runs above: the methods of the
+ *        class, then the fields of the object, so both are found by name.
+ */
+static void push_object_frames(char *name, Obj *object) {
+    stack_push(callStack, frame_create_with_variables(name, object->data.object.shape->methods));
+    stack_push(callStack, frame_create_for_object(name, object));
+}
+
+Value evaluate_function(ParseNode *node) {
+    Obj *func = gc_malloc();
+    func->type = TYPE_FUNCTION;
+    func->data.node = node;
+
+    Value func_value = OBJ_VAL(func);
+    assign_variable(node_left(node), func_value);
 
     // // Use the value in the hashtable instead
     // free(func_value);
     // hashtable_get(stack_peek(callStack)->local_variables,
-    //             node->left->value.data.stringValue,
+    //             node->left->name,
     //             &func_value);
 
     return func_value;
 }
 
-Value *evaluate_list(ParseNode *node) {
-    List *list = list_create(1);
-    node = node->right;
-    while(node!=NULL) {
-        list_add(&list, evaluate(node));
-        node = node->right;
-    }
-
-    Value *list_value = gc_malloc();
+Value evaluate_list(ParseNode *node) {
+    // Allocated first so the items are reachable while the rest are evaluated
+    Obj *list_value = gc_malloc();
     list_value->type = TYPE_LIST;
-    list_value->data.list = list;
+    list_value->data.list = list_create(node->item_count);
+    gc_push_root(OBJ_VAL(list_value));
 
-    return list_value;
-}
-
-Value *evaluate_map(ParseNode *node) {
-    HashMap *map = hashmap_create(1);
-    node = node->right;
-    while(node!=NULL) {
-        Value *key = evaluate(node->left->left);
-        Value *value = evaluate(node->left->right);
-        if (key->type != TYPE_STRING) {
-            runtime_error(node, "Map key must be a string");
-            return NULL;
-        }
-        hashmap_set(map, key->data.stringValue, value);
-        node = node->right;
+    for (int i = 0; i < node->item_count; i++) {
+        Value item = evaluate(node_item(node, i));
+        list_add(list_value->data.list, item);
     }
 
-    Value *map_value = gc_malloc();
+    gc_pop_roots(1);
+    return OBJ_VAL(list_value);
+}
+
+Value evaluate_map(ParseNode *node) {
+    HashMap *map = hashmap_create(0);
+    Obj *map_value = gc_malloc();
     map_value->type = TYPE_MAP;
     map_value->data.map = map;
+    gc_push_root(OBJ_VAL(map_value));
+
+    for (int i = 0; i < node->item_count; i++) {
+        ParseNode *pair = node_item(node, i);
+        Value key = evaluate(node_left(pair));
+        gc_push_root(key);
+        Value value = evaluate(node_right(pair));
+        gc_pop_roots(1);
+        if (value_type(key) != TYPE_STRING) {
+            runtime_error(pair, "Map key must be a string");
+            gc_pop_roots(1);
+            return NONE_VAL;
+        }
+        hashmap_set(map, AS_STRING(key), value);
+    }
+    gc_pop_roots(1);
 
     if (debug_mode) {
-        printf("Map created with %ld entries\n", map->size);
+        printf("Map created with %ld entries\n", map->table.count);
     }
 
-    return map_value;
+    return OBJ_VAL(map_value);
 }
 
-Value *evaluate_op_index(ParseNode *node) {
-    Value *container = evaluate(node->left);
-    Value *index = evaluate(node->right);
+Value evaluate_op_index(ParseNode *node) {
+    Value container = evaluate(node_left(node));
+    gc_push_root(container);
+    Value index = evaluate(node_right(node));
+    gc_pop_roots(1);
+    return apply_op_index(node, container, index);
+}
 
-    if (container->type == TYPE_LIST) {
-        if (index->type != TYPE_INT) {
+Value apply_op_index(ParseNode *node, Value container, Value index) {
+    if (value_type(container) == TYPE_LIST) {
+        if (!IS_INT(index)) {
             runtime_error(node, "List index must be int");
-            return NULL;
+            return NONE_VAL;
         }
 
-        return list_access(container->data.list, index->data.intValue);
+        return list_access(AS_LIST(container), AS_INT(index));
 
-    } else if (container->type == TYPE_MAP) {
-        if (index->type != TYPE_STRING) {
+    } else if (value_type(container) == TYPE_MAP) {
+        if (value_type(index) != TYPE_STRING) {
             runtime_error(node, "Map index must be a string");
-            return NULL;
+            return NONE_VAL;
         }
-        Value *value;
-        bool found = hashmap_get(container->data.map, index->data.stringValue, &value);
+        Value value;
+        bool found = hashmap_get(AS_MAP(container), AS_STRING(index), &value);
         if (!found) {
             runtime_error(node, "Key not found in map");
-            return NULL;
+            return NONE_VAL;
         }
         return value;
     } else {
         runtime_error(node, "Indexing non-list");
-        return NULL;
+        return NONE_VAL;
     }
 }
 
-Value *evaluate_identifier(ParseNode *node) {
-    Value *id_value;
-    int found = stack_get_value(callStack, node->value.data.stringValue, &id_value);
+Value evaluate_identifier(ParseNode *node) {
+    Value id_value;
+    int found = stack_lookup(callStack, node_scope(node), node->slot, node_name(node), &id_value);
     if (found == 0) {
         error_and_exit(node, "Identifier not yet declared");
     }
-    switch (id_value->type) {
+    switch (value_type(id_value)) {
         case TYPE_FUNCTION:
             return execute_function(node, id_value);
+        case TYPE_NATIVE:
+            return execute_native(node, id_value);
         case TYPE_CLASS:
             return build_object(node, id_value);
         default:
@@ -323,224 +509,421 @@ Value *evaluate_identifier(ParseNode *node) {
     }
 }
 
-Value *evaluate_while(ParseNode *node) {
-    Value *value = NULL;
-    while (evaluate(node->left)->data.intValue) {
-        value = evaluate(node->right);
+Value evaluate_while(ParseNode *node) {
+    Value value = NONE_VAL;
+    gc_push_root(value);
+    while (is_truthy(evaluate(node_left(node)))) {
+        value = evaluate(node_right(node));
+        if (stack_peek(callStack)->status == 1) break;
+        // Keep the latest result, it is returned once the loop ends
+        gc_pop_roots(1);
+        gc_push_root(value);
+
+        // A hot loop runs its remaining iterations as native code
+        if (jit_enabled && jit_loop(node, &value)) break;
     }
+    gc_pop_roots(1);
     return value;
 }
 
-Value *evaluate_for(ParseNode *node) {
-    Value *return_value = NULL;
+Value evaluate_for(ParseNode *node) {
+    Value return_value = NONE_VAL;
 
     // Initialise
-    evaluate(node->left->left);
+    evaluate(node_left(node_left(node)));
+
+    gc_push_root(return_value);
+    while(is_truthy(evaluate(node_left(node_right(node_left(node)))))) {
+        return_value = evaluate(node_right(node));
+        if (stack_peek(callStack)->status == 1) break;
+        gc_pop_roots(1);
+        gc_push_root(return_value);
+        evaluate(node_right(node_right(node_left(node)))); // The change like i++;
 
-    while(evaluate(node->left->right->left)->data.intValue) {
-        return_value = evaluate(node->right);
-        evaluate(node->left->right->right); // The change like i++;
+        if (jit_enabled && jit_loop(node, &return_value)) break;
     }
+    gc_pop_roots(1);
     
     return return_value;
 }
 
-Value *evaluate_literal(ParseNode *node) {
-    Value *value = gc_malloc();
-    value->type = node->value.type;
-    value->data = node->value.data;
+Value evaluate_literal(ParseNode *node) {
+    return node_literal(node);
+}
+
+Value evaluate_op_add(ParseNode *node) {
+    Value left = evaluate(node_left(node));
+    gc_push_root(left);
+    Value right = evaluate(node_right(node));
+    gc_pop_roots(1);
 
-    return value;
+    // A recursive call may have quickened this node while the operands ran
+    node->type = OP_ADD;
+    Value result = apply_op_add(node, left, right);
+    quicken(node, left, right);
+    return result;
 }
 
-Value *evaluate_op_add(ParseNode *node) {
-    Value *left = evaluate(node->left);
-    Value *right = evaluate(node->right);
-    if (left->type == TYPE_INT || left->type == TYPE_FLOAT) {
-        return evaluate_op_binary(node); // TODO: look at if double evaluation left and right has side effects
+Value apply_op_add(ParseNode *node, Value left, Value right) {
+    if (IS_INT(left) || IS_FLOAT(left)) {
+        return apply_op_binary(node, left, right);
     }
 
-    Value *result = gc_malloc();
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        result->type = TYPE_STRING;
-        unsigned int len_left = strlen(left->data.stringValue);
-        unsigned int len_right = strlen(right->data.stringValue);
-        char *concat = malloc(len_left + len_right + 1);  // +1 for '\0'
-        if (!concat) {
-            error_and_exit(node, "Malloc Failed");
-        }
-        strcpy(concat, left->data.stringValue);
-        strcat(concat, right->data.stringValue);
-        
-        result->data.stringValue = concat;
+    if (value_type(left) == TYPE_STRING && value_type(right) == TYPE_STRING) {
+        return rope_concat(left, right);
     } 
-    else if (left->type == TYPE_LIST && right->type == TYPE_LIST) {
+    else if (value_type(left) == TYPE_LIST && value_type(right) == TYPE_LIST) {
+        // The operands may no longer be rooted, so they are copied after gc_malloc()
+        gc_push_root(left);
+        gc_push_root(right);
+        Obj *result = gc_malloc();
+        gc_pop_roots(2);
+
+        int length = AS_LIST(left)->tail + AS_LIST(right)->tail + 2;
+        List *list = list_create(length);
+        list_copy(AS_LIST(left), list, 0);
+        list_copy(AS_LIST(right), list, AS_LIST(left)->tail + 1);
         result->type = TYPE_LIST;
-        int length = left->data.list->tail + right->data.list->tail + 2;
-        result->data.list = list_create(length);
-        list_copy(left->data.list, result->data.list, 0);
-        list_copy(right->data.list, result->data.list, left->data.list->tail + 1);
+        result->data.list = list;
+        return OBJ_VAL(result);
     }
     else {
         runtime_error(node, "Incompatible types for OP_ADD");
-        free(result);
-        return NULL;
+        return NONE_VAL;
     }
-    return result;
 }
 
-Value *evaluate_op_binary_int(ParseNode *node, Value *result, int left, int right) {
-    switch (node->type) {
-        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
-            result->type = TYPE_INT;
-            break;
-        default:
-            result->type = TYPE_BOOL;
-    }
+Value evaluate_op_binary_int(ParseNode *node, int left, int right) {
     switch (node->type) {
         case OP_ADD:
-            result->data.intValue = left + right; break;
+            return INT_VAL(left + right);
         case OP_SUB:
-            result->data.intValue = left - right; break;
+            return INT_VAL(left - right);
         case OP_MUL:
-            result->data.intValue = left * right; break;
+            return INT_VAL(left * right);
         case OP_DIV:
-            result->data.intValue = left / right; break;
+            return INT_VAL(left / right);
         case OP_MOD:
-            result->data.intValue = left % right; break;
+            return INT_VAL(left % right);
         case OP_GT:
-            result->data.intValue = left > right; break;
+            return BOOL_VAL(left > right);
         case OP_GTE:
-            result->data.intValue = left >= right; break;
+            return BOOL_VAL(left >= right);
         case OP_LT:
-            result->data.intValue = left < right; break;
+            return BOOL_VAL(left < right);
         case OP_LTE:
-            result->data.intValue = left <= right; break;
-        case OP_AND:
-            result->data.intValue = left && right; break;
-        case OP_OR:
-            result->data.intValue = left || right; break;
+            return BOOL_VAL(left <= right);
         default:
             runtime_error(node, "Operator not supported on integers");
+            return NONE_VAL;
     }
-
-    return result;
 }
 
-Value *evaluate_op_binary_float(ParseNode *node, Value *result, double left, double right) {
-    switch (node->type) {
-        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
-            result->type = TYPE_FLOAT;
-            break;
-        default:
-            result->type = TYPE_BOOL;
-    }
+Value evaluate_op_binary_float(ParseNode *node, double left, double right) {
     switch (node->type) {
         case OP_ADD:
-            result->data.floatValue = left + right; break;
+            return FLOAT_VAL(left + right);
         case OP_SUB:
-            result->data.floatValue = left - right; break;
+            return FLOAT_VAL(left - right);
         case OP_MUL:
-            result->data.floatValue = left * right; break;
+            return FLOAT_VAL(left * right);
         case OP_DIV:
-            result->data.floatValue = left / right; break;
+            return FLOAT_VAL(left / right);
         case OP_GT:
-            result->data.intValue = left > right; break;
+            return BOOL_VAL(left > right);
         case OP_GTE:
-            result->data.intValue = left >= right; break;
+            return BOOL_VAL(left >= right);
         case OP_LT:
-            result->data.intValue = left < right; break;
+            return BOOL_VAL(left < right);
         case OP_LTE:
-            result->data.intValue = left <= right; break;
+            return BOOL_VAL(left <= right);
         default:
             runtime_error(node, "Operator not supported on floats");
+            return NONE_VAL;
     }
+}
 
+Value evaluate_op_binary(ParseNode *node) {
+    TokenType op = node->type;
+    Value left = evaluate(node_left(node));
+    gc_push_root(left);
+    Value right = evaluate(node_right(node));
+    gc_pop_roots(1);
+
+    node->type = op;
+    Value result = apply_op_binary(node, left, right);
+    quicken(node, left, right);
     return result;
 }
 
-Value *evaluate_op_binary(ParseNode *node) {
-    Value *left = evaluate(node->left);
-    Value *right = evaluate(node->right);
-    Value *result = gc_malloc();
-
-    if (left->type == TYPE_INT && right->type == TYPE_INT) {
-        evaluate_op_binary_int(node, result, left->data.intValue, right->data.intValue);
-        return result;
+Value apply_op_binary(ParseNode *node, Value left, Value right) {
+    if (IS_INT(left) && IS_INT(right)) {
+        return evaluate_op_binary_int(node, AS_INT(left), AS_INT(right));
     }
-    else if (left->type == TYPE_FLOAT && right->type == TYPE_FLOAT) {
-        evaluate_op_binary_float(node, result, left->data.floatValue, right->data.floatValue);
-        return result;
+    else if (IS_FLOAT(left) && IS_FLOAT(right)) {
+        return evaluate_op_binary_float(node, AS_FLOAT(left), AS_FLOAT(right));
     }
-    else if (left->type == TYPE_INT && right->type == TYPE_FLOAT) {
-        evaluate_op_binary_int(node, result, left->data.intValue, (int)right->data.floatValue);
-        return result;
+    else if (IS_INT(left) && IS_FLOAT(right)) {
+        return evaluate_op_binary_int(node, AS_INT(left), (int)AS_FLOAT(right));
     }
-    else if (left->type == TYPE_FLOAT && right->type == TYPE_INT) {
-        evaluate_op_binary_float(node, result, left->data.floatValue, (double)right->data.intValue);
-        return result;
+    else if (IS_FLOAT(left) && IS_INT(right)) {
+        return evaluate_op_binary_float(node, AS_FLOAT(left), (double)AS_INT(right));
     }
-    else if (left->type == TYPE_BOOL && right->type == TYPE_BOOL) {
-        evaluate_op_binary_int(node, result, left->data.intValue, right->data.intValue);
-        return result;
+    else if (IS_BOOL(left) && IS_BOOL(right)) {
+        return evaluate_op_binary_int(node, AS_BOOL(left), AS_BOOL(right));
     }
     else {
         runtime_error(node, "Incompatible types for OPERATOR");
-        return NULL;
+        return NONE_VAL;
+    }
+}
+
+/**
+ * @brief Evaluate && or ||, skipping the right operand when the left one
+ *        already decides the result.
+ * @return true or false.
+ */
+Value evaluate_op_logical(ParseNode *node) {
+    bool left = is_truthy(evaluate(node_left(node)));
+    if (node->type == OP_AND ? !left : left) {
+        return BOOL_VAL(left);
+    }
+    return BOOL_VAL(is_truthy(evaluate(node_right(node))));
+}
+
+Value evaluate_op_eq(ParseNode *node) {
+    Value left = evaluate(node_left(node));
+    gc_push_root(left);
+    Value right = evaluate(node_right(node));
+    gc_pop_roots(1);
+
+    node->type = OP_EQ;
+    Value result = apply_op_eq(node, left, right);
+    quicken(node, left, right);
+    return result;
+}
+
+Value evaluate_op_neq(ParseNode *node) {
+    Value left = evaluate(node_left(node));
+    gc_push_root(left);
+    Value right = evaluate(node_right(node));
+    gc_pop_roots(1);
+
+    node->type = OP_NEQ;
+    Value result = apply_op_eq(node, left, right);
+    quicken(node, left, right);
+    return result;
+}
+
+/**
+ * The int and float variant of each operator that has them. NONE where the
+ * generic operator fails or compares differently for that type.
+ */
+static const struct {
+    TokenType generic;
+    TokenType int_variant;
+    TokenType float_variant;
+} quick_ops[] = {
+    { OP_ADD, OP_ADD_INT, OP_ADD_FLOAT },
+    { OP_SUB, OP_SUB_INT, OP_SUB_FLOAT },
+    { OP_MUL, OP_MUL_INT, OP_MUL_FLOAT },
+    { OP_DIV, OP_DIV_INT, OP_DIV_FLOAT },
+    { OP_MOD, OP_MOD_INT, NONE },
+    { OP_GT,  OP_GT_INT,  OP_GT_FLOAT },
+    { OP_GTE, OP_GTE_INT, OP_GTE_FLOAT },
+    { OP_LT,  OP_LT_INT,  OP_LT_FLOAT },
+    { OP_LTE, OP_LTE_INT, OP_LTE_FLOAT },
+    { OP_EQ,  OP_EQ_INT,  NONE },
+    { OP_NEQ, OP_NEQ_INT, NONE },
+};
+
+#define QUICK_OP_COUNT (sizeof(quick_ops) / sizeof(quick_ops[0]))
+
+/**
+ * @brief Rewrite a generic arithmetic or comparison node into its int or
+ *        float variant once both operands had that type, so the following
+ *        evaluations skip the type checks. A node that had to be turned
+ *        back by deoptimise() is left generic.
+ */
+static void quicken(ParseNode *node, Value left, Value right) {
+    if (node->unstable) return;
+
+    for (size_t i = 0; i < QUICK_OP_COUNT; i++) {
+        if (quick_ops[i].generic != node->type) continue;
+
+        if (IS_INT(left) && IS_INT(right)) {
+            node->type = quick_ops[i].int_variant;
+        } else if (IS_FLOAT(left) && IS_FLOAT(right) && quick_ops[i].float_variant != NONE) {
+            node->type = quick_ops[i].float_variant;
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Turn a quickened node back into its generic operator after an operand
+ *        of another type, and finish the operation the generic way.
+ * @param left The evaluated left operand.
+ * @param right The evaluated right operand.
+ */
+static Value deoptimise(ParseNode *node, Value left, Value right) {
+    for (size_t i = 0; i < QUICK_OP_COUNT; i++) {
+        if (quick_ops[i].int_variant == node->type || quick_ops[i].float_variant == node->type) {
+            node->type = quick_ops[i].generic;
+            break;
+        }
+    }
+    node->unstable = true;
+
+    switch (node->type) {
+        case OP_ADD: return apply_op_add(node, left, right);
+        case OP_EQ: case OP_NEQ: return apply_op_eq(node, left, right);
+        default: return apply_op_binary(node, left, right);
+    }
+}
+
+/**
+ * @brief Deoptimise when the left operand already has the wrong type, the
+ *        right one is still to be evaluated.
+ */
+static Value deoptimise_left(ParseNode *node, Value left) {
+    gc_push_root(left);
+    Value right = evaluate(node_right(node));
+    gc_pop_roots(1);
+    return deoptimise(node, left, right);
+}
+
+/**
+ * Quickened operators. Operands that are both ints or both floats need no
+ * rooting, as they are not on the heap.
+ */
+#define QUICK_OP(name, IS_TYPE, AS_TYPE, RESULT, op)             \
+    static Value name(ParseNode *node) {                           \
+        Value left = evaluate(node_left(node));                         \
+        if (!IS_TYPE(left)) return deoptimise_left(node, left);    \
+        Value right = evaluate(node_right(node));                       \
+        if (!IS_TYPE(right)) return deoptimise(node, left, right); \
+        return RESULT(AS_TYPE(left) op AS_TYPE(right));            \
+    }
+
+QUICK_OP(evaluate_add_int, IS_INT, AS_INT, INT_VAL, +)
+QUICK_OP(evaluate_sub_int, IS_INT, AS_INT, INT_VAL, -)
+QUICK_OP(evaluate_mul_int, IS_INT, AS_INT, INT_VAL, *)
+QUICK_OP(evaluate_div_int, IS_INT, AS_INT, INT_VAL, /)
+QUICK_OP(evaluate_mod_int, IS_INT, AS_INT, INT_VAL, %)
+QUICK_OP(evaluate_gt_int, IS_INT, AS_INT, BOOL_VAL, >)
+QUICK_OP(evaluate_gte_int, IS_INT, AS_INT, BOOL_VAL, >=)
+QUICK_OP(evaluate_lt_int, IS_INT, AS_INT, BOOL_VAL, <)
+QUICK_OP(evaluate_lte_int, IS_INT, AS_INT, BOOL_VAL, <=)
+QUICK_OP(evaluate_eq_int, IS_INT, AS_INT, BOOL_VAL, ==)
+QUICK_OP(evaluate_neq_int, IS_INT, AS_INT, BOOL_VAL, !=)
+QUICK_OP(evaluate_add_float, IS_FLOAT, AS_FLOAT, FLOAT_VAL, +)
+QUICK_OP(evaluate_sub_float, IS_FLOAT, AS_FLOAT, FLOAT_VAL, -)
+QUICK_OP(evaluate_mul_float, IS_FLOAT, AS_FLOAT, FLOAT_VAL, *)
+QUICK_OP(evaluate_div_float, IS_FLOAT, AS_FLOAT, FLOAT_VAL, /)
+QUICK_OP(evaluate_gt_float, IS_FLOAT, AS_FLOAT, BOOL_VAL, >)
+QUICK_OP(evaluate_gte_float, IS_FLOAT, AS_FLOAT, BOOL_VAL, >=)
+QUICK_OP(evaluate_lt_float, IS_FLOAT, AS_FLOAT, BOOL_VAL, <)
+QUICK_OP(evaluate_lte_float, IS_FLOAT, AS_FLOAT, BOOL_VAL, <=)
+
+#undef QUICK_OP
+
+static Value (*const quickened[])(ParseNode *node) = {
+    [OP_ADD_INT] = evaluate_add_int,     [OP_ADD_FLOAT] = evaluate_add_float,
+    [OP_SUB_INT] = evaluate_sub_int,     [OP_SUB_FLOAT] = evaluate_sub_float,
+    [OP_MUL_INT] = evaluate_mul_int,     [OP_MUL_FLOAT] = evaluate_mul_float,
+    [OP_DIV_INT] = evaluate_div_int,     [OP_DIV_FLOAT] = evaluate_div_float,
+    [OP_MOD_INT] = evaluate_mod_int,
+    [OP_GT_INT]  = evaluate_gt_int,      [OP_GT_FLOAT]  = evaluate_gt_float,
+    [OP_GTE_INT] = evaluate_gte_int,     [OP_GTE_FLOAT] = evaluate_gte_float,
+    [OP_LT_INT]  = evaluate_lt_int,      [OP_LT_FLOAT]  = evaluate_lt_float,
+    [OP_LTE_INT] = evaluate_lte_int,     [OP_LTE_FLOAT] = evaluate_lte_float,
+    [OP_EQ_INT]  = evaluate_eq_int,
+    [OP_NEQ_INT] = evaluate_neq_int,
+};
+
+/**
+ * @brief Evaluate a node rewritten by quicken().
+ */
+Value evaluate_quickened(ParseNode *node) {
+    return quickened[node->type](node);
+}
+
+static bool is_numeric(Value value) {
+    return IS_INT(value) || IS_FLOAT(value) || IS_BOOL(value);
+}
+
+static double numeric_value(Value value) {
+    if (IS_INT(value)) return AS_INT(value);
+    if (IS_BOOL(value)) return AS_BOOL(value);
+    return AS_FLOAT(value);
+}
+
+Value apply_op_eq(ParseNode *node, Value left, Value right) {
+    // Numbers, bools and strings compare by value, anything else on the heap by identity
+    bool equal;
+    if (is_numeric(left) && is_numeric(right)) {
+        equal = numeric_value(left) == numeric_value(right);
+    } else if (value_type(left) == TYPE_STRING && value_type(right) == TYPE_STRING) {
+        equal = string_equal(left, right);
+    } else {
+        equal = left == right;
     }
+    return BOOL_VAL(node->type == OP_NEQ ? !equal : equal);
 }
 
-Value *evaluate_op_eq(ParseNode *node) { // TODO: add string support
-    Value *eq = gc_malloc();
-    eq->type = TYPE_BOOL;
-    eq->data.intValue = evaluate(node->left)->data.intValue == evaluate(node->right)->data.intValue;
-    return eq;
+Value evaluate_op_not(ParseNode *node) {
+    return apply_op_not(evaluate(node_left(node)));
 }
 
-Value *evaluate_op_neq(ParseNode *node) { // TODO: add string support
-    Value *neq = gc_malloc();
-    neq->type = TYPE_BOOL;
-    neq->data.intValue = evaluate(node->left)->data.intValue != evaluate(node->right)->data.intValue;
-    return neq;
+Value apply_op_not(Value operand) {
+    return BOOL_VAL(!is_truthy(operand));
 }
 
-Value *evaluate_op_not(ParseNode *node) {
-    Value *not = gc_malloc();
-    not->type = TYPE_BOOL;
-    not->data.intValue = !evaluate(node->left)->data.intValue;
-    return not;
+/**
+ * @brief Whether a value counts as true in a condition. None, false, zero and
+ *        unbound values are false, strings and anything on the heap are true.
+ */
+bool is_truthy(Value value) {
+    if (IS_BOOL(value)) return AS_BOOL(value);
+    if (IS_INT(value)) return AS_INT(value) != 0;
+    if (IS_FLOAT(value)) return AS_FLOAT(value) != 0.0;
+    return IS_OBJ(value) || IS_SHORT_STRING(value);
 }
 
-Value *evaluate_if(ParseNode *node) {
-    if ( evaluate(node->left)->data.intValue == 1 ) { 
-        return evaluate(node->right->left); 
-    } else if (node->right->right != NULL){
-        return evaluate(node->right->right);
+Value evaluate_if(ParseNode *node) {
+    if (is_truthy(evaluate(node_left(node)))) {
+        return evaluate(node_left(node_right(node))); 
+    } else if (node_right(node_right(node)) != NULL){
+        return evaluate(node_right(node_right(node)));
     } else {
-        return NULL;
+        return NONE_VAL;
     }
 }
 
-Value *evaluate_out(ParseNode *node) {
-    Value *to_out = evaluate(node->left);
-    switch(to_out->type) {
+Value evaluate_out(ParseNode *node) {
+    return apply_out(node, evaluate(node_left(node)));
+}
+
+Value apply_out(ParseNode *node, Value to_out) {
+    switch(value_type(to_out)) {
         case TYPE_INT:
-            printf("%d\n",to_out->data.intValue);
+            printf("%d\n",AS_INT(to_out));
             break;
         case TYPE_FLOAT:
-            printf(".2%f\n",to_out->data.floatValue);
+            printf(".2%f\n",AS_FLOAT(to_out));
             break;
         case TYPE_STRING:
-            printf("%s\n",to_out->data.stringValue);
+            printf("%s\n",AS_STRING(to_out));
             break;
         default:
             runtime_error(node, "Invalid Output Type");
-            return NULL;
+            return NONE_VAL;
     }
-    return value_copy(to_out);
+    return to_out;
 }
 
-Value *evaluate_in(ParseNode *node) {
+Value evaluate_in(ParseNode *node) {
     char *line = NULL;
     size_t len = 0;
     int nread;
@@ -558,42 +941,124 @@ Value *evaluate_in(ParseNode *node) {
         nread--;
     }
 
-    Value *in = gc_malloc();
+    if (nread >= 0 && nread <= SHORT_STRING_MAX) {
+        Value short_line = short_string_val(line, nread);
+        free(line);
+        return short_line;
+    }
+
+    Obj *in = gc_malloc();
     in->type = TYPE_STRING;
     in->data.stringValue = line;
-    return in;
+    in->length = nread > 0 ? nread : 0;
+    return OBJ_VAL(in);
 }
 
-Value *evaluate_return(ParseNode *node) {
-    stack_peek(callStack)->status = 1;
-    return evaluate(node->left);
+Value evaluate_return(ParseNode *node) {
+    StackFrame *top = stack_peek(callStack);
+    top->status = 1;
+
+    // The resolver gave the scope of the function to returns of a call in tail
+    // position, whose frame can be handed over once nothing else may read it
+    if (node_scope(node) == NULL || !node_scope(node)->private || top->scope != node_scope(node)) {
+        return evaluate(node_left(node));
+    }
+
+    ParseNode *call = node_left(node);
+    Value callee;
+    if (!stack_lookup(callStack, node_scope(call), call->slot, node_name(call), &callee)) {
+        error_and_exit(call, "Identifier not yet declared");
+    }
+    switch (value_type(callee)) {
+        case TYPE_FUNCTION:
+            break;
+        case TYPE_NATIVE:
+            return execute_native(call, callee);
+        case TYPE_CLASS:
+            return build_object(call, callee);
+        default:
+            return callee;
+    }
+
+    ParseNode *definition = AS_NODE(callee);
+    ParseNode *params = node_left(definition);
+    int bound = params->item_count < call->item_count ? params->item_count : call->item_count;
+
+    // An argument may make a tail call of its own, which uses tail_call
+    // before this one is set up, so the arguments are gathered apart first
+    Value local_args[TAIL_CALL_LOCAL_ARGS];
+    Value *args = local_args;
+    if (bound > TAIL_CALL_LOCAL_ARGS) {
+        args = malloc(bound * sizeof(Value));
+        if (!args) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < bound; i++) {
+        args[i] = evaluate(node_item(call, i));
+        gc_push_root(args[i]);
+    }
+
+    if (bound > tail_call.capacity) {
+        tail_call.capacity = bound < 8 ? 8 : bound;
+        tail_call.args = realloc(tail_call.args, tail_call.capacity * sizeof(Value));
+        if (!tail_call.args) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    memcpy(tail_call.args, args, bound * sizeof(Value));
+    tail_call.argc = bound;
+    gc_pop_roots(bound); // Rooted by tail_call from here
+    if (args != local_args) {
+        free(args);
+    }
+
+    // The statement lists unwind to execute_function, which runs the call
+    tail_call.site = call;
+    tail_call.definition = definition;
+    return NONE_VAL;
 }
 
-Value *execute_function(ParseNode *node, Value *id_value) {
-    // Create new stack frame for function call
-    StackFrame* frame = frame_create(node->value.data.stringValue);
+Value execute_function(ParseNode *node, Value id_value) {
+    ParseNode *definition = AS_NODE(id_value);
 
-    // Get the param and arg
-    ParseNode *param = id_value->data.node->left->right;
-    ParseNode *arg = node->right;
+    // Create new stack frame for function call
+    StackFrame* frame = frame_create(node_name(node), node_scope(definition));
 
     // Bind parameter to argument
-    while (param && arg) {
-        Value *value = evaluate(arg);
-        hashtable_set(frame->local_variables, 
-                    param->value.data.stringValue, 
-                    value);
-
-        param = param->right;
-        arg = arg->right;
+    ParseNode *params = node_left(definition);
+    int bound = 0;
+    while (bound < params->item_count && bound < node->item_count) {
+        Value value = evaluate(node_item(node, bound));
+        frame_set_slot(frame, node_item(params, bound)->slot, value);
+        gc_push_root(value); // The frame is not on the call stack yet
+        bound++;
     }
 
     // Push new variables onto callstack
     stack_push(callStack, frame);
+    gc_pop_roots(bound);
+
+    // Evaluate function body, natively once the function is hot. A call in
+    // tail position takes over the frame and runs in its place.
+    Value result;
+    for (;;) {
+        if (!jit_enabled || !jit_call(definition, frame, &result)) {
+            result = evaluate(node_right(definition));
+        }
+        if (tail_call.site == NULL) break;
+
+        definition = tail_call.definition;
+        frame_reset(frame, node_name(tail_call.site), node_scope(definition));
+        for (int i = 0; i < tail_call.argc; i++) {
+            frame_set_slot(frame, node_item(node_left(definition), i)->slot, tail_call.args[i]);
+        }
+        tail_call.argc = 0;
+        tail_call.site = NULL;
+    }
 
-    // Evaluate function body
-    Value *result = evaluate(id_value->data.node->right);
-    
     // Clean up stack frame
     frame = stack_pop(callStack);
     frame_destroy(frame, 1);
@@ -601,66 +1066,76 @@ Value *execute_function(ParseNode *node, Value *id_value) {
     return result;
 }
 
-Value *build_object(ParseNode *node, Value *class) {
-    
-    HashTable *local_variables = hashtable_create(128); // TODO: make bucket size not literal
+/**
+ * @brief Call a builtin. Unlike a function it gets every argument.
+ */
+Value execute_native(ParseNode *node, Value native) {
+    Value *args = malloc((node->item_count + 1) * sizeof(Value));
+    if (!args) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < node->item_count; i++) {
+        args[i] = evaluate(node_item(node, i));
+        gc_push_root(args[i]);
+    }
 
-    // Get the param and arg
-    ParseNode *param = class->data.node->left->right;
-    ParseNode *arg = node->right;
+    Value result = AS_NATIVE(native)(node, args, node->item_count);
 
-    // Bind parameter to argument
-    while (param && arg) {
-        Value *value = evaluate(arg);
-        hashtable_set(local_variables, 
-                    param->value.data.stringValue, 
-                    value);
+    gc_pop_roots(node->item_count);
+    free(args);
+    return result;
+}
 
-        param = param->right;
-        arg = arg->right;
-    }
+Value build_object(ParseNode *node, Value class) {
+    ParseNode *definition = AS_NODE(class);
+    Value object = object_create(node_shape(definition));
+    gc_push_root(object); // The fields are not on the call stack yet
 
-    // Create a frame that will be auto filled with the object fields
-    StackFrame *frame = frame_create_with_variables(node->value.data.stringValue, local_variables);
+    // Bind parameter to argument
+    ParseNode *params = node_left(definition);
+    int bound = 0;
+    while (bound < params->item_count && bound < node->item_count) {
+        Value value = evaluate(node_item(node, bound));
+        object_set_field(AS_OBJ(object), node_name(node_item(params, bound)), value);
+        bound++;
+    }
 
-    stack_push(callStack, frame);
-    Value *body = evaluate(class->data.node->right);
-    StackFrame *fields_stack = stack_pop(callStack);
+    // The class body fills in the other fields through the object's frame
+    push_object_frames(node_name(node), AS_OBJ(object));
+    gc_pop_roots(1);
+    evaluate_class_body(node_right(definition));
 
-    Value *obj = gc_malloc();
-    obj->type = TYPE_OBJECT;
-    obj->data.object_fields = fields_stack->local_variables;
-    frame_destroy(fields_stack, 0);
+    frame_destroy(stack_pop(callStack), 0);
+    frame_destroy(stack_pop(callStack), 0);
 
-    hashtable_set(local_variables, "self", obj);
+    object_set_field(AS_OBJ(object), intern_string("self"), object);
 
-    return obj;
+    return object;
 }
 
-Value *call_object(ParseNode *node) {
+Value call_object(ParseNode *node) {
 
-    Value *obj = evaluate(node->left);
-    if (!obj || obj->type != TYPE_OBJECT) {
+    Value obj = evaluate(node_left(node));
+    if (value_type(obj) != TYPE_OBJECT) {
         runtime_error(node, "Dot operator on non-object");
-        return NULL;
+        return NONE_VAL;
     }
 
-    // Look up field/method in object's hash table
-    Value *member;
-    int found = hashtable_get(obj->data.object_fields, node->right->value.data.stringValue, &member);
+    Value member;
+    int found = object_member(node, obj, node_name(node_right(node)), &member);
     if (!found) {
         runtime_error(node, "Invalid member for object");
     }
 
-    switch (member->type) {
+    switch (value_type(member)) {
         case TYPE_FUNCTION:
-            StackFrame* frame = frame_create_with_variables(node->value.data.stringValue, obj->data.object_fields);
-            stack_push(callStack, frame);
+            push_object_frames(node_name(node), AS_OBJ(obj));
 
-            Value *result = execute_function(node->right, member);
+            Value result = execute_function(node_right(node), member);
 
-            frame = stack_pop(callStack);
-            frame_destroy(frame, 0);
+            frame_destroy(stack_pop(callStack), 0);
+            frame_destroy(stack_pop(callStack), 0);
 
             return result;
         default:
@@ -676,6 +1151,13 @@ void runtime_error(ParseNode *node, char* string) {
 
 void cleanup() {
     stack_destroy(callStack);
+    callStack = NULL;
+
+    gc_remove_roots(&tail_call.args);
+    free(tail_call.args);
+    tail_call.args = NULL;
+    tail_call.argc = 0;
+    tail_call.capacity = 0;
 }
 
 void error_and_exit(ParseNode *node, char* string) {
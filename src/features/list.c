@@ -1,15 +1,45 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "features/list.h"
 
-List *list_create(int length) {
+/**
+ * @brief Create an empty list.
+ * @param capacity The number of items to allocate room for, such as the
+ *        length of a list literal, so it is filled without growing.
+ * @return A pointer to the list.
+ */
+List *list_create(int capacity) {
+    if (capacity < LIST_MIN_CAPACITY) {
+        capacity = LIST_MIN_CAPACITY;
+    }
+
     List *list = malloc(sizeof(List));
-    list->items = malloc(length*sizeof(Value));
-    list->array_length = length;
+    Value *items = malloc(capacity * sizeof(Value));
+    if (!list || !items) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    list->items = items;
+    list->array_length = capacity;
     list->tail = -1;
 
     return list;
 }
 
+/**
+ * @brief Make room for at least capacity items, growing the items in place.
+ */
+void list_reserve(List *list, int capacity) {
+    if (capacity <= list->array_length) return;
+
+    list->items = realloc(list->items, capacity * sizeof(Value));
+    if (!list->items) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    list->array_length = capacity;
+}
+
 void list_copy(List *original, List *target, int offset) {
     if (original->tail > target->array_length + offset) {
         fprintf(stderr, "Cannot copy list to smaller list\nOriginal: %d\nTarget: %d\n",original->tail, target->array_length + offset);
@@ -23,30 +53,28 @@ void list_copy(List *original, List *target, int offset) {
     target->tail = original->tail + offset;
 }
 
-void list_add(List **plist, Value *item) {
-    List *list = *plist;
-
+/**
+ * @brief Append an item, doubling the room for items when the list is full
+ *        so appending n items reallocates O(log n) times.
+ */
+void list_add(List *list, Value item) {
     if (list->tail + 1 >= list->array_length) {
-        List *new_list = list_create(list->array_length*2);
-        list_copy(list, new_list, 0);
-        list_destroy(list); // Cleanup old list
-        list = new_list;
-        *plist = new_list;
+        list_reserve(list, list->array_length * 2);
     }
 
     list->items[++list->tail] = item;
 }
 
-Value *list_access(List *list, int index) {
+Value list_access(List *list, int index) {
     if (index < 0 || index > list->tail) {
         fprintf(stderr, "Invalid index for list\n");
-        return NULL;
+        return NONE_VAL;
     }
 
     return list->items[index];
 }
 
-void list_edit(List *list, int index, Value *item) {
+void list_edit(List *list, int index, Value item) {
     if (index < 0 || index > list->tail) {
         fprintf(stderr, "Invalid index for list\n");
         return;
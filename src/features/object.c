@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "features/object.h"
+#include "garbage_collector.h"
+
+static Shape *shape_allocate(HashTable *methods, int field_count) {
+    Shape *shape = calloc(1, sizeof(Shape));
+    if (!shape) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    table_init(&shape->slots, field_count);
+    shape->field_count = field_count;
+    shape->methods = methods;
+    return shape;
+}
+
+/**
+ * @brief Create the root shape of a class, which has no fields.
+ * @param methods The methods of the class, owned by the shape from now on.
+ * @return The shape, freed with shape_destroy().
+ */
+Shape *shape_create(HashTable *methods) {
+    return shape_allocate(methods, 0);
+}
+
+/**
+ * @brief Find the slot of a field.
+ * @param shape The shape of the object.
+ * @param name The interned field name.
+ * @return The slot, or -1 if objects of this shape do not have the field.
+ */
+int shape_find(Shape *shape, const char *name) {
+    Value slot;
+    return table_get(&shape->slots, name, &slot) ? AS_INT(slot) : -1;
+}
+
+/**
+ * @brief Get the shape an object moves to when it gains a field. Each
+ *        transition is only created once, so objects that add the same
+ *        fields in the same order end up with the same shape.
+ */
+static Shape *shape_transition(Shape *shape, char *name) {
+    for (int i = 0; i < shape->transition_count; i++) {
+        if (shape->transitions[i].name == name) {
+            return shape->transitions[i].shape;
+        }
+    }
+
+    Shape *next = shape_allocate(shape->methods, shape->field_count + 1);
+    for (size_t i = 0; i < shape->slots.capacity; i++) {
+        Entry *entry = &shape->slots.entries[i];
+        if (entry->key != NULL) {
+            table_set(&next->slots, entry->key, entry->value);
+        }
+    }
+    table_set(&next->slots, name, INT_VAL(shape->field_count));
+
+    if (shape->transition_count + 1 > shape->transition_capacity) {
+        shape->transition_capacity = shape->transition_capacity < 2 ? 2 : shape->transition_capacity * 2;
+        shape->transitions = realloc(shape->transitions, shape->transition_capacity * sizeof(ShapeTransition));
+        if (!shape->transitions) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    shape->transitions[shape->transition_count++] = (ShapeTransition){name, next};
+    return next;
+}
+
+static void shape_free(Shape *shape) {
+    for (int i = 0; i < shape->transition_count; i++) {
+        shape_free(shape->transitions[i].shape);
+    }
+    free(shape->transitions);
+    table_free(&shape->slots);
+    free(shape);
+}
+
+/**
+ * @brief Free the root shape of a class, every shape reached from it and the
+ *        table of methods. The method values themselves belong to the collector.
+ */
+void shape_destroy(Shape *root) {
+    if (!root) return;
+    hashtable_destroy(root->methods);
+    shape_free(root);
+}
+
+/**
+ * @brief Create an object without fields.
+ * @param shape The root shape of its class.
+ * @return The object, which the caller has to keep reachable.
+ */
+Value object_create(Shape *shape) {
+    Obj *object = gc_malloc();
+    object->type = TYPE_OBJECT;
+    object->data.object.shape = shape;
+    object->data.object.fields = NULL;
+    return OBJ_VAL(object);
+}
+
+bool object_get_field(Obj *object, const char *name, Value *out_value) {
+    int slot = shape_find(object->data.object.shape, name);
+    if (slot < 0) return false;
+    *out_value = object->data.object.fields[slot];
+    return true;
+}
+
+// Field arrays hold a power of two values, at least 4, so the capacity follows from the count
+static int fields_capacity(int count) {
+    int capacity = 4;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * @brief Set a field of an object, adding it if the object does not have it.
+ * @param object The object.
+ * @param name The interned field name.
+ * @param value The value of the field.
+ */
+void object_set_field(Obj *object, char *name, Value value) {
+    Shape *shape = object->data.object.shape;
+    int slot = shape_find(shape, name);
+    if (slot < 0) {
+        slot = shape->field_count;
+        if (object->data.object.fields == NULL || fields_capacity(slot + 1) > fields_capacity(slot)) {
+            object->data.object.fields = realloc(object->data.object.fields, fields_capacity(slot + 1) * sizeof(Value));
+            if (!object->data.object.fields) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        object->data.object.shape = shape_transition(shape, name);
+    }
+    object->data.object.fields[slot] = value;
+}
+
+/**
+ * @brief Look up a member of an object for an OP_DOT node: a field of the
+ *        object, then a method of its class. The node caches where the member
+ *        was found for up to INLINE_CACHE_SIZE shapes, so a site that sees
+ *        objects of a few shapes reads fields by slot without hashing.
+ * @param site The OP_DOT node.
+ * @param object The object.
+ * @param name The interned member name.
+ * @param out_member Set to the member if found.
+ * @return Whether the object has the member.
+ */
+bool object_member(ParseNode *site, Value object, const char *name, Value *out_member) {
+    Obj *obj = AS_OBJ(object);
+    Shape *shape = obj->data.object.shape;
+    InlineCache *cache = node_cache(site);
+
+    if (cache != NULL) {
+        for (int i = 0; i < cache->count; i++) {
+            if (cache->shapes[i] == shape) {
+                *out_member = cache->slots[i] >= 0 ? obj->data.object.fields[cache->slots[i]] : cache->methods[i];
+                return true;
+            }
+        }
+    }
+
+    int slot = shape_find(shape, name);
+    Value method = NONE_VAL;
+    if (slot >= 0) {
+        *out_member = obj->data.object.fields[slot];
+    } else if (hashtable_get(shape->methods, name, &method)) {
+        *out_member = method;
+    } else {
+        return false;
+    }
+
+    if (cache == NULL) {
+        cache = calloc(1, sizeof(InlineCache));
+        if (!cache) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        node_set_cache(site, cache);
+    }
+    // A site that has seen more shapes than fit stays uncached
+    if (cache->count < INLINE_CACHE_SIZE) {
+        cache->shapes[cache->count] = shape;
+        cache->slots[cache->count] = slot;
+        cache->methods[cache->count] = method;
+        cache->count++;
+    }
+    return true;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "features/rope.h"
+#include "garbage_collector.h"
+
+/**
+ * @brief Get the number of characters of a string, without flattening it.
+ */
+size_t string_length(Value string) {
+    return IS_SHORT_STRING(string) ? short_string_length(string) : (size_t)AS_OBJ(string)->length;
+}
+
+/**
+ * @brief Whether two strings have the same characters. Short strings are
+ *        equal exactly when their values are, as are interned strings when
+ *        they share their characters, and strings of different lengths never
+ *        are, so only the rest are compared in full.
+ * @param left A string value.
+ * @param right A string value.
+ */
+bool string_equal(Value left, Value right) {
+    if (left == right) return true;
+    if (IS_SHORT_STRING(left) && IS_SHORT_STRING(right)) return false;
+
+    size_t length = string_length(left);
+    if (length != string_length(right)) return false;
+    if (IS_OBJ(left) && IS_OBJ(right) && AS_OBJ(left)->interned && AS_OBJ(right)->interned) {
+        return AS_OBJ(left)->data.stringValue == AS_OBJ(right)->data.stringValue;
+    }
+    return memcmp(AS_STRING(left), AS_STRING(right), length) == 0;
+}
+
+/**
+ * @brief Concatenate two strings. Results of up to SHORT_STRING_MAX characters
+ *        are held in the value, and other short results are copied into a flat
+ *        string the collector frees. Longer ones become a rope that refers to
+ *        both halves and is only flattened once its characters are needed, so
+ *        building a string piece by piece takes linear time.
+ * @param left A string value.
+ * @param right A string value.
+ * @return A new string value.
+ */
+Value rope_concat(Value left, Value right) {
+    size_t left_length = string_length(left);
+    size_t right_length = string_length(right);
+    size_t length = left_length + right_length;
+
+    if (length < ROPE_MIN_LENGTH) {
+        // The operands may no longer be rooted, so they are read before gc_malloc()
+        char chars[ROPE_MIN_LENGTH];
+        memcpy(chars, AS_STRING(left), left_length);
+        memcpy(chars + left_length, AS_STRING(right), right_length);
+        if (length <= SHORT_STRING_MAX) {
+            return short_string_val(chars, length);
+        }
+
+        // Not interned, since the intern table is never swept and programs
+        // may build any number of distinct strings
+        char *copy = malloc(length + 1);
+        if (!copy) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        memcpy(copy, chars, length);
+        copy[length] = '\0';
+
+        Obj *result = gc_malloc();
+        result->type = TYPE_STRING;
+        result->length = length;
+        result->data.stringValue = copy;
+        return OBJ_VAL(result);
+    }
+
+    gc_push_root(left);
+    gc_push_root(right);
+    Obj *result = gc_malloc();
+    gc_pop_roots(2);
+
+    result->type = TYPE_STRING;
+    result->rope = true;
+    result->length = length;
+    result->data.rope.left = left;
+    result->data.rope.right = right;
+    return OBJ_VAL(result);
+}
+
+/**
+ * @brief Copy the characters of a rope into one buffer, which the string then
+ *        holds instead of its halves.
+ * @param string A string, flat strings are returned as they are.
+ * @return The null terminated characters, owned by the string.
+ */
+char *rope_flatten(Obj *string) {
+    if (!string->rope) return string->data.stringValue;
+
+    char *chars = malloc(string->length + 1);
+    if (!chars) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Ropes built in a loop are as deep as the loop is long, so the right
+    // halves still to copy are kept on a stack rather than recursing
+    Value *pending = NULL;
+    int count = 0;
+    int capacity = 0;
+    size_t position = 0;
+    Value node = OBJ_VAL(string);
+    for (;;) {
+        while (IS_OBJ(node) && AS_OBJ(node)->rope) {
+            if (count + 1 > capacity) {
+                capacity = capacity < 16 ? 16 : capacity * 2;
+                pending = realloc(pending, capacity * sizeof(Value));
+                if (!pending) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(1);
+                }
+            }
+            pending[count++] = AS_OBJ(node)->data.rope.right;
+            node = AS_OBJ(node)->data.rope.left;
+        }
+
+        size_t length = string_length(node);
+        memcpy(chars + position, AS_STRING(node), length);
+        position += length;
+
+        if (count == 0) break;
+        node = pending[--count];
+    }
+    chars[position] = '\0';
+    free(pending);
+
+    string->rope = false;
+    string->data.stringValue = chars;
+    return chars;
+}
@@ -1,20 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include "token.h"
+#include "garbage_collector.h"
+#include "evaluator.h"
+#include "utils/call_stack.h"
+#include "features/object.h"
+#include "utils/hash_table.h"
+#include "features/hashmap.h"
+#include "features/list.h"
 
-void gc_reference(Value *value) {
-    value->references = value->references + 1;
+#define GC_INITIAL_THRESHOLD 1024
+#define GC_GROWTH_FACTOR 2
+#define MAX_ROOT_ARRAYS 8
+
+/**
+ * An array of values owned by another module, such as the stack of the
+ * virtual machine. Both fields are pointers so the array can grow.
+ */
+typedef struct RootArray {
+    Value **values;
+    int *count;
+} RootArray;
+
+typedef struct GarbageCollector {
+    Obj *objects;           // Every object from gc_malloc(), linked through next
+    int object_count;
+    int next_collection;    // Collect once object_count reaches this
+
+    Obj **gray;             // Marked objects whose children are not marked yet
+    int gray_count;
+    int gray_capacity;
+
+    Value *roots;           // Temporaries pushed with gc_push_root()
+    int root_count;
+    int root_capacity;
+
+    RootArray root_arrays[MAX_ROOT_ARRAYS];
+    int root_array_count;
+} GarbageCollector;
+
+GarbageCollector gc = { .next_collection = GC_INITIAL_THRESHOLD };
+
+/**
+ * @brief Pin a heap value so it is kept alive while something the collector
+ *        cannot see, like a chunk's constant pool, refers to it.
+ * @param value The value to pin, ignored if it is not on the heap.
+ */
+void gc_reference(Value value) {
+    if (!IS_OBJ(value)) return;
+    AS_OBJ(value)->references++;
+}
+
+/**
+ * @brief Release a pin taken with gc_reference(). The value is freed by the
+ *        next collection if nothing else reaches it.
+ * @param value The value to unpin, ignored if it is not on the heap.
+ */
+void gc_dereference(Value value) {
+    if (!IS_OBJ(value)) return;
+    AS_OBJ(value)->references--;
+}
+
+/**
+ * @brief Allocate a heap object tracked by the collector, collecting first
+ *        once enough objects have been allocated since the last collection.
+ *        Any object the caller still needs must be reachable from a root.
+ * @return A pointer to the zeroed object.
+ */
+Obj *gc_malloc() {
+    if (gc.object_count >= gc.next_collection) {
+        gc_collect();
+    }
+
+    Obj *object = calloc(1, sizeof(Obj));
+    if (!object) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    object->references = 0;
+    object->next = gc.objects;
+    gc.objects = object;
+    gc.object_count++;
+    return object;
+}
+
+/**
+ * @brief Keep a value alive while it is only held by a C local, for example
+ *        the left operand while the right one is evaluated.
+ * @param value The value to protect.
+ */
+void gc_push_root(Value value) {
+    if (gc.root_count + 1 > gc.root_capacity) {
+        gc.root_capacity = gc.root_capacity < 16 ? 16 : gc.root_capacity * 2;
+        gc.roots = realloc(gc.roots, gc.root_capacity * sizeof(Value));
+        if (!gc.roots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    gc.roots[gc.root_count++] = value;
+}
+
+void gc_pop_roots(int count) {
+    gc.root_count -= count;
+}
+
+/**
+ * @brief Register an array of values to scan on every collection.
+ * @param values A pointer to the array, which may be reallocated.
+ * @param count A pointer to the number of values in use.
+ */
+void gc_add_roots(Value **values, int *count) {
+    if (gc.root_array_count >= MAX_ROOT_ARRAYS) {
+        fprintf(stderr, "Too many root arrays\n");
+        exit(1);
+    }
+    gc.root_arrays[gc.root_array_count++] = (RootArray){ values, count };
+}
+
+void gc_remove_roots(Value **values) {
+    for (int i = 0; i < gc.root_array_count; i++) {
+        if (gc.root_arrays[i].values == values) {
+            gc.root_arrays[i] = gc.root_arrays[--gc.root_array_count];
+            return;
+        }
+    }
+}
+
+static void mark_object(Obj *object) {
+    if (object->marked) return;
+    object->marked = true;
+
+    // Flat strings have no children, so they never need to be traced
+    if (object->type == TYPE_STRING && !object->rope) return;
+
+    if (gc.gray_count + 1 > gc.gray_capacity) {
+        gc.gray_capacity = gc.gray_capacity < 64 ? 64 : gc.gray_capacity * 2;
+        gc.gray = realloc(gc.gray, gc.gray_capacity * sizeof(Obj*));
+        if (!gc.gray) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    gc.gray[gc.gray_count++] = object;
+}
+
+static void mark_value(Value value) {
+    if (IS_OBJ(value)) {
+        mark_object(AS_OBJ(value));
+    }
+}
+
+static void mark_table(Table *table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->entries[i].key != NULL) {
+            mark_value(table->entries[i].value);
+        }
+    }
+}
+
+static void mark_fields(HashTable *fields) {
+    if (fields == NULL) return;
+    mark_table(&fields->table);
+}
+
+static void mark_call_stack(CallStack *stack) {
+    if (stack == NULL) return;
+
+    for (int i = 0; i <= stack->top; i++) {
+        StackFrame *frame = stack->frames[i];
+        if (frame->scope) {
+            for (int slot = 0; slot < frame->scope->count; slot++) {
+                mark_value(frame->slots[slot]);
+            }
+        }
+        mark_fields(frame->local_variables);
+        if (frame->object) {
+            mark_object(frame->object);
+        }
+    }
 }
 
-void gc_dereference(Value *value) { 
-    value->references = value->references - 1;
+static void mark_roots() {
+    for (Obj *object = gc.objects; object != NULL; object = object->next) {
+        if (object->references > 0) {
+            mark_object(object);
+        }
+    }
+    for (int i = 0; i < gc.root_count; i++) {
+        mark_value(gc.roots[i]);
+    }
+    for (int i = 0; i < gc.root_array_count; i++) {
+        Value *values = *gc.root_arrays[i].values;
+        int count = *gc.root_arrays[i].count;
+        for (int j = 0; j < count; j++) {
+            mark_value(values[j]);
+        }
+    }
+    mark_call_stack(callStack);
+}
+
+static void trace_references() {
+    while (gc.gray_count > 0) {
+        Obj *object = gc.gray[--gc.gray_count];
+        switch (object->type) {
+            case TYPE_LIST:
+                for (int i = 0; i <= object->data.list->tail; i++) {
+                    mark_value(object->data.list->items[i]);
+                }
+                break;
+            case TYPE_MAP:
+                mark_table(&object->data.map->table);
+                break;
+            case TYPE_STRING:
+                mark_value(object->data.rope.left);
+                mark_value(object->data.rope.right);
+                break;
+            case TYPE_OBJECT:
+                for (int i = 0; i < object->data.object.shape->field_count; i++) {
+                    mark_value(object->data.object.fields[i]);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
 
-    if (value->references == 0) {
-        value_destroy(*value);
-        free(value);
+static void sweep() {
+    Obj **link = &gc.objects;
+    while (*link != NULL) {
+        Obj *object = *link;
+        if (object->marked) {
+            object->marked = false;
+            link = &object->next;
+        } else {
+            *link = object->next;
+            value_destroy(object);
+            free(object);
+            gc.object_count--;
+        }
     }
 }
 
-Value *gc_malloc() {
-    Value *value = calloc(1, sizeof(Value));
-    value->references = 0;
-    return value;
-}
\ No newline at end of file
+/**
+ * @brief Free every object that cannot be reached from the call stack, the
+ *        registered root arrays, the pushed temporaries or a pinned value.
+ */
+void gc_collect() {
+    mark_roots();
+    trace_references();
+    sweep();
+
+    gc.next_collection = gc.object_count * GC_GROWTH_FACTOR;
+    if (gc.next_collection < GC_INITIAL_THRESHOLD) {
+        gc.next_collection = GC_INITIAL_THRESHOLD;
+    }
+}
+
+/**
+ * @brief Free every tracked object, reachable or not. Used at exit.
+ */
+void gc_free_all() {
+    Obj *object = gc.objects;
+    while (object != NULL) {
+        Obj *next = object->next;
+        value_destroy(object);
+        free(object);
+        object = next;
+    }
+    gc.objects = NULL;
+    gc.object_count = 0;
+
+    free(gc.gray);
+    free(gc.roots);
+    gc.gray = NULL;
+    gc.roots = NULL;
+    gc.gray_capacity = gc.root_capacity = 0;
+    gc.gray_count = gc.root_count = 0;
+}
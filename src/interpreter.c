@@ -4,34 +4,67 @@
 #include <assert.h>
 #include "utils/file_utils.h"
 #include "utils/hash_table.h"
+#include "utils/intern.h"
+#include "utils/arena.h"
+#include "utils/call_stack.h"
 #include "features/list.h"
 #include "token.h"
 #include "lexer.h"
 #include "parser.h"
 #include "evaluator.h"
+#include "resolver.h"
+#include "optimiser.h"
+#include "jit.h"
+#include "transpiler.h"
+#include "compiler.h"
+#include "vm.h"
+#include "garbage_collector.h"
 
-#define MAX_TOKEN_COUNT 128
 #define MAX_SYMBOL_COUNT 128
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Must provide filename\nOptional flags\n\t--debug: prints more information\n");
-        exit(0);
-    }
-
-    char *filename = argv[1];
+    char *filename = NULL;
     int debug = 0;
+    int use_vm = 0;
+    int optimise = 1;
+    int emit = 0;
 
-    if (argc > 2 && strcmp(argv[2], "--debug") == 0) {
-        debug = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--debug") == 0) {
+            debug = 1;
+        } else if (strcmp(argv[i], "--vm") == 0) {
+            use_vm = 1;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            optimise = 0;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            set_jit_mode(true);
+        } else if (strcmp(argv[i], "--emit-c") == 0) {
+            emit = 1;
+        } else if (strcmp(argv[i], "--max-depth") == 0) {
+            int depth = i + 1 < argc ? atoi(argv[++i]) : 0;
+            if (depth < 1) {
+                fprintf(stderr, "--max-depth must be followed by a positive number of frames\n");
+                exit(1);
+            }
+            stack_set_max_depth(depth);
+        } else if (argv[i][0] != '-' && filename == NULL) {
+            filename = argv[i];
+        }
     }
 
+    if (filename == NULL) {
+        printf("Must provide filename\nOptional flags\n\t--debug: prints more information\n\t--vm: runs on the bytecode virtual machine\n\t-O0: disables the optimiser\n\t--jit: compiles hot loops and functions to native code\n\t--emit-c: prints the program translated to C instead of running it\n\t--max-depth <n>: the deepest calls may nest, 10000 by default\n");
+        exit(0);
+    }
+    set_optimisation_level(optimise);
+
     if (debug) printf("Running file: %s\n", filename);
-    char *input = read_file(filename);
+    size_t mapped_length;
+    char *input = map_file(filename, &mapped_length);
 
     if (input) {
         // Tokenisation
-        int token_count = MAX_TOKEN_COUNT;
+        int token_count;
         Token *tokens = tokenize(input, &token_count);
         if (tokens != NULL) {
             if (debug) printf("Tokenisation Successful\n");
@@ -41,24 +74,60 @@ int main(int argc, char *argv[]) {
 
         if (debug) printf("Token Count: %d\n", token_count);
 
-        // Parsing
-        ParseNode *ast = parse(tokens, token_count);
+        // Parsing, the tree is kept in an arena freed in one go at exit
+        Arena *arena = arena_create();
+        ParseNode *ast = parse(tokens, token_count, arena);
         if (ast != NULL) {
             if (debug) printf("\nParsing Successful\n");
         } else {
             fprintf(stderr, "\nParsing failed\n");
         }
 
+        // The tree only refers to interned text, not the tokens or source
+        free_tokens(tokens, token_count);
+        unmap_file(input, mapped_length);
+
         // Debug check parsing
         if (debug) {
             print_ast(ast);
             printf("\n");
         }
 
+        optimise_program(ast, arena);
+        if (debug && optimise) {
+            printf("\nOptimised: ");
+            print_ast(ast);
+            printf("\n");
+        }
+
+        resolve_program(ast);
+
+        if (emit) {
+            int status = emit_c(ast, filename, stdout);
+            arena_destroy(arena);
+            intern_free_all();
+            node_store_free();
+            return status;
+        }
+
         set_debug_mode_evaluator(debug);
 
-        Value *return_value = evaluate(ast);
-        if (return_value == NULL) {
+        Value return_value;
+        if (use_vm) {
+            set_debug_mode_vm(debug);
+
+            Chunk *chunk = compile(ast);
+            if (debug) {
+                disassemble_chunk(chunk, filename);
+                printf("\n");
+            }
+
+            return_value = vm_run(chunk);
+            chunk_destroy(chunk);
+        } else {
+            return_value = evaluate(ast);
+        }
+        if (IS_NONE(return_value)) {
             fprintf(stderr, "Evaluation failed\n");
         }
 
@@ -68,13 +137,12 @@ int main(int argc, char *argv[]) {
             printf("\n");
         }
         
-        free_ast(ast);
-        free_tokens(tokens, token_count);
-        free(input);
-        if (return_value != NULL) {
-            value_destroy(*return_value);
-            free(return_value);
-        }
+        arena_destroy(arena);
+        free_imports();
+        jit_free_all();
+        gc_free_all();
+        intern_free_all();
+        node_store_free();
     } else {
         fprintf(stderr, "File read failed\n");
     }
@@ -0,0 +1,657 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "jit.h"
+#include "resolver.h"
+#include "evaluator.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#define JIT_HOT_LOOP 1000          // Back-edges before a loop is compiled
+#define JIT_HOT_CALLS 1000         // Calls before a function body is compiled
+#define JIT_MAX_GUARD_FAILURES 8   // Before compiled code is thrown away
+#define JIT_MAX_COMPILATIONS 4     // Of one region, as its types keep changing
+#define REGION_MIN_CAPACITY 16
+
+bool jit_enabled = false;
+
+typedef enum {
+    REGION_COUNTING,
+    REGION_COMPILED,
+    REGION_FAILED
+} RegionState;
+
+/**
+ * Static type of the value a compiled node leaves in rax, always NaN-boxed.
+ * A slot is only ever compiled as JIT_INT or JIT_FLOAT, JIT_UNUSED marks a
+ * slot the region does not touch.
+ */
+typedef enum {
+    JIT_UNUSED,
+    JIT_INT,
+    JIT_FLOAT,
+    JIT_BOOL,
+    JIT_ANY,
+    JIT_UNSUPPORTED
+} JitType;
+
+// Compiled code takes the slots of the frame in rdi and the latest value of
+// the loop body in rsi, and returns the value of the loop or function
+typedef Value (*NativeCode)(Value *slots, Value last);
+
+typedef struct Region {
+    ParseNode *node;     // Loop or function compiled, NULL for an empty entry
+    RegionState state;
+    int count;           // Back-edges or calls while counting, guard failures once compiled
+    int compilations;
+    Scope *scope;        // Scope of the frame the code reads and writes
+    uint8_t *slot_types; // JitType of every slot, checked before each run
+    NativeCode code;
+    size_t code_size;
+} Region;
+
+// Regions keyed by node, as parse nodes have no room left for them
+static Region *regions = NULL;
+static size_t region_capacity = 0;
+static size_t region_count = 0;
+
+void set_jit_mode(bool enabled) {
+    if (enabled && !JIT_SUPPORTED) {
+        fprintf(stderr, "JIT is not supported on this platform, interpreting instead\n");
+        enabled = false;
+    }
+    jit_enabled = enabled;
+}
+
+#if JIT_SUPPORTED
+
+static size_t hash_node(ParseNode *node) {
+    // Nodes are numbered in the order they were parsed
+    return node_index(node);
+}
+
+static Region *insert_region(Region *entries, size_t capacity, ParseNode *node) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash_node(node) & mask; ; i = (i + 1) & mask) {
+        if (entries[i].node == node || entries[i].node == NULL) {
+            return &entries[i];
+        }
+    }
+}
+
+static void grow_regions() {
+    size_t capacity = region_capacity < REGION_MIN_CAPACITY ? REGION_MIN_CAPACITY : region_capacity * 2;
+    Region *entries = calloc(capacity, sizeof(Region));
+    if (!entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < region_capacity; i++) {
+        if (regions[i].node != NULL) {
+            *insert_region(entries, capacity, regions[i].node) = regions[i];
+        }
+    }
+    free(regions);
+    regions = entries;
+    region_capacity = capacity;
+}
+
+/**
+ * @brief Get the region of a loop or function, adding it on first use.
+ */
+static Region *find_region(ParseNode *node) {
+    if ((region_count + 1) * 4 > region_capacity * 3) {
+        grow_regions();
+    }
+    Region *region = insert_region(regions, region_capacity, node);
+    if (region->node == NULL) {
+        region->node = node;
+        region->state = REGION_COUNTING;
+        region_count++;
+    }
+    return region;
+}
+
+// Machine code templates. The immediates, displacements and jump offsets
+// they end with are written right after them by the emit_* helpers.
+static const uint8_t LOAD_RAX[] = { 0x48, 0xb8 };              // mov rax, imm64
+static const uint8_t LOAD_RCX[] = { 0x48, 0xb9 };              // mov rcx, imm64
+static const uint8_t LOAD_SLOT[] = { 0x48, 0x8b, 0x87 };       // mov rax, [rdi + disp32]
+static const uint8_t STORE_SLOT[] = { 0x48, 0x89, 0x87 };      // mov [rdi + disp32], rax
+static const uint8_t STORE_LAST[] = { 0x48, 0x89, 0x04, 0x24 };// mov [rsp], rax
+static const uint8_t PUSH_RAX[] = { 0x50 };                    // push rax
+static const uint8_t PUSH_LAST[] = { 0x56 };                   // push rsi
+static const uint8_t POP_RAX[] = { 0x58 };                     // pop rax
+static const uint8_t POP_LEFT[] = { 0x48, 0x89, 0xc1, 0x58 };  // mov rcx, rax; pop rax
+static const uint8_t OR_TAG[] = { 0x48, 0x09, 0xc8 };          // or rax, rcx
+static const uint8_t RET[] = { 0xc3 };
+static const uint8_t JMP[] = { 0xe9 };                         // jmp rel32
+static const uint8_t JZ[] = { 0x0f, 0x84 };                    // jz rel32
+static const uint8_t JNZ[] = { 0x0f, 0x85 };                   // jnz rel32
+
+// Int operators, left operand in eax and right in ecx
+static const uint8_t ADD_INT[] = { 0x01, 0xc8 };                     // add eax, ecx
+static const uint8_t SUB_INT[] = { 0x29, 0xc8 };                     // sub eax, ecx
+static const uint8_t MUL_INT[] = { 0x0f, 0xaf, 0xc1 };               // imul eax, ecx
+static const uint8_t DIV_INT[] = { 0x99, 0xf7, 0xf9 };               // cdq; idiv ecx
+static const uint8_t MOD_INT[] = { 0x99, 0xf7, 0xf9, 0x89, 0xd0 };   // cdq; idiv ecx; mov eax, edx
+static const uint8_t CMP_INT[] = { 0x39, 0xc8 };                     // cmp eax, ecx
+static const uint8_t TEST_INT[] = { 0x85, 0xc0 };                    // test eax, eax
+static const uint8_t TEST_BOOL[] = { 0xa8, 0x01 };                   // test al, 1
+
+// Float operators, left operand in xmm0 and right in xmm1
+static const uint8_t UNBOX_FLOATS[] = {
+    0x66, 0x48, 0x0f, 0x6e, 0xc0,                                    // movq xmm0, rax
+    0x66, 0x48, 0x0f, 0x6e, 0xc9                                     // movq xmm1, rcx
+};
+static const uint8_t BOX_FLOAT[] = { 0x66, 0x48, 0x0f, 0x7e, 0xc0 }; // movq rax, xmm0
+static const uint8_t ADD_FLOAT[] = { 0xf2, 0x0f, 0x58, 0xc1 };       // addsd xmm0, xmm1
+static const uint8_t SUB_FLOAT[] = { 0xf2, 0x0f, 0x5c, 0xc1 };       // subsd xmm0, xmm1
+static const uint8_t MUL_FLOAT[] = { 0xf2, 0x0f, 0x59, 0xc1 };       // mulsd xmm0, xmm1
+static const uint8_t DIV_FLOAT[] = { 0xf2, 0x0f, 0x5e, 0xc1 };       // divsd xmm0, xmm1
+static const uint8_t CMP_FLOAT[] = { 0x66, 0x0f, 0x2e, 0xc1 };       // ucomisd xmm0, xmm1
+static const uint8_t CMP_FLOAT_SWAPPED[] = { 0x66, 0x0f, 0x2e, 0xc8 };// ucomisd xmm1, xmm0
+
+// Flags to a bool in al
+static const uint8_t SETE[] = { 0x0f, 0x94, 0xc0 };
+static const uint8_t SETNE[] = { 0x0f, 0x95, 0xc0 };
+static const uint8_t SETL[] = { 0x0f, 0x9c, 0xc0 };
+static const uint8_t SETLE[] = { 0x0f, 0x9e, 0xc0 };
+static const uint8_t SETG[] = { 0x0f, 0x9f, 0xc0 };
+static const uint8_t SETGE[] = { 0x0f, 0x9d, 0xc0 };
+static const uint8_t SETA[] = { 0x0f, 0x97, 0xc0 };
+static const uint8_t SETAE[] = { 0x0f, 0x93, 0xc0 };
+static const uint8_t AND_ORDERED[] = { 0x0f, 0x9b, 0xc1, 0x20, 0xc8 };  // setnp cl; and al, cl
+static const uint8_t OR_UNORDERED[] = { 0x0f, 0x9a, 0xc1, 0x08, 0xc8 }; // setp cl; or al, cl
+static const uint8_t ZERO_EXTEND[] = { 0x0f, 0xb6, 0xc0 };              // movzx eax, al
+
+#define EMIT(template) emit(template, sizeof(template))
+
+static uint8_t *buffer = NULL;
+static size_t buffer_length = 0;
+static size_t buffer_capacity = 0;
+
+static Region *compiling;  // Region the code is compiled for
+static Value *live_slots;  // Slots of the frame at compile time, giving their types
+
+static void emit(const uint8_t *bytes, size_t length) {
+    if (buffer_length + length > buffer_capacity) {
+        buffer_capacity = buffer_capacity == 0 ? 256 : buffer_capacity * 2;
+        if (buffer_capacity < buffer_length + length) {
+            buffer_capacity = buffer_length + length;
+        }
+        buffer = realloc(buffer, buffer_capacity);
+        if (!buffer) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    memcpy(buffer + buffer_length, bytes, length);
+    buffer_length += length;
+}
+
+static void emit_u32(uint32_t value) {
+    emit((uint8_t *)&value, sizeof(value));
+}
+
+static void emit_u64(uint64_t value) {
+    emit((uint8_t *)&value, sizeof(value));
+}
+
+static void emit_load(Value value) {
+    EMIT(LOAD_RAX);
+    emit_u64(value);
+}
+
+/**
+ * @brief Emit a jump whose offset is patched later.
+ * @return Where the offset is in the buffer.
+ */
+static size_t emit_jump(const uint8_t *opcode, size_t length) {
+    emit(opcode, length);
+    emit_u32(0);
+    return buffer_length - 4;
+}
+
+static void patch_jump(size_t offset, size_t target) {
+    int32_t relative = (int32_t)(target - (offset + 4));
+    memcpy(buffer + offset, &relative, sizeof(relative));
+}
+
+#define EMIT_JUMP(opcode) emit_jump(opcode, sizeof(opcode))
+
+/**
+ * @brief Tag the int in eax, the upper half of rax being zero.
+ */
+static JitType emit_box_int() {
+    EMIT(LOAD_RCX);
+    emit_u64(QNAN | TAG_INT);
+    EMIT(OR_TAG);
+    return JIT_INT;
+}
+
+/**
+ * @brief Turn the flag in al into true or false.
+ */
+static JitType emit_box_bool() {
+    EMIT(ZERO_EXTEND);
+    EMIT(LOAD_RCX);
+    emit_u64(FALSE_VAL); // TRUE_VAL only differs in the lowest bit
+    EMIT(OR_TAG);
+    return JIT_BOOL;
+}
+
+/**
+ * @brief Set the zero flag when the value in rax is falsy, as is_truthy()
+ *        would decide.
+ * @return false if values of the type are not supported in a condition.
+ */
+static bool emit_test(JitType type) {
+    switch (type) {
+        case JIT_INT: EMIT(TEST_INT); return true;
+        case JIT_BOOL: EMIT(TEST_BOOL); return true;
+        default: return false;
+    }
+}
+
+/**
+ * @brief The operator a quickened node was specialised from.
+ */
+static TokenType generic_op(TokenType type) {
+    switch (type) {
+        case OP_ADD_INT: case OP_ADD_FLOAT: return OP_ADD;
+        case OP_SUB_INT: case OP_SUB_FLOAT: return OP_SUB;
+        case OP_MUL_INT: case OP_MUL_FLOAT: return OP_MUL;
+        case OP_DIV_INT: case OP_DIV_FLOAT: return OP_DIV;
+        case OP_MOD_INT: return OP_MOD;
+        case OP_GT_INT: case OP_GT_FLOAT: return OP_GT;
+        case OP_GTE_INT: case OP_GTE_FLOAT: return OP_GTE;
+        case OP_LT_INT: case OP_LT_FLOAT: return OP_LT;
+        case OP_LTE_INT: case OP_LTE_FLOAT: return OP_LTE;
+        case OP_EQ_INT: return OP_EQ;
+        case OP_NEQ_INT: return OP_NEQ;
+        default: return type;
+    }
+}
+
+/**
+ * @brief The type of a slot variable, taken from its value when the region is
+ *        compiled. Only variables of the frame running the region are
+ *        supported, anything else is looked up by name.
+ */
+static JitType slot_type(ParseNode *identifier) {
+    if (identifier->item_count != 0 || identifier->slot < 0 || node_scope(identifier) != compiling->scope) {
+        return JIT_UNSUPPORTED;
+    }
+
+    uint8_t *type = &compiling->slot_types[identifier->slot];
+    if (*type == JIT_UNUSED) {
+        Value value = live_slots[identifier->slot];
+        if (IS_INT(value)) {
+            *type = JIT_INT;
+        } else if (IS_FLOAT(value)) {
+            *type = JIT_FLOAT;
+        } else {
+            *type = JIT_UNSUPPORTED;
+        }
+    }
+    return *type;
+}
+
+static JitType compile_node(ParseNode *node);
+
+static JitType compile_int_op(TokenType op) {
+    switch (op) {
+        case OP_ADD: EMIT(ADD_INT); return emit_box_int();
+        case OP_SUB: EMIT(SUB_INT); return emit_box_int();
+        case OP_MUL: EMIT(MUL_INT); return emit_box_int();
+        // A zero divisor traps just as the interpreter's own division does
+        case OP_DIV: EMIT(DIV_INT); return emit_box_int();
+        case OP_MOD: EMIT(MOD_INT); return emit_box_int();
+        case OP_GT: EMIT(CMP_INT); EMIT(SETG); return emit_box_bool();
+        case OP_GTE: EMIT(CMP_INT); EMIT(SETGE); return emit_box_bool();
+        case OP_LT: EMIT(CMP_INT); EMIT(SETL); return emit_box_bool();
+        case OP_LTE: EMIT(CMP_INT); EMIT(SETLE); return emit_box_bool();
+        case OP_EQ: EMIT(CMP_INT); EMIT(SETE); return emit_box_bool();
+        case OP_NEQ: EMIT(CMP_INT); EMIT(SETNE); return emit_box_bool();
+        default: return JIT_UNSUPPORTED;
+    }
+}
+
+static JitType compile_float_op(TokenType op) {
+    EMIT(UNBOX_FLOATS);
+    switch (op) {
+        case OP_ADD: EMIT(ADD_FLOAT); EMIT(BOX_FLOAT); return JIT_FLOAT;
+        case OP_SUB: EMIT(SUB_FLOAT); EMIT(BOX_FLOAT); return JIT_FLOAT;
+        case OP_MUL: EMIT(MUL_FLOAT); EMIT(BOX_FLOAT); return JIT_FLOAT;
+        case OP_DIV: EMIT(DIV_FLOAT); EMIT(BOX_FLOAT); return JIT_FLOAT;
+        // Comparisons with NaN are false, the unordered result sets CF and ZF
+        case OP_GT: EMIT(CMP_FLOAT); EMIT(SETA); return emit_box_bool();
+        case OP_GTE: EMIT(CMP_FLOAT); EMIT(SETAE); return emit_box_bool();
+        case OP_LT: EMIT(CMP_FLOAT_SWAPPED); EMIT(SETA); return emit_box_bool();
+        case OP_LTE: EMIT(CMP_FLOAT_SWAPPED); EMIT(SETAE); return emit_box_bool();
+        case OP_EQ: EMIT(CMP_FLOAT); EMIT(SETE); EMIT(AND_ORDERED); return emit_box_bool();
+        case OP_NEQ: EMIT(CMP_FLOAT); EMIT(SETNE); EMIT(OR_UNORDERED); return emit_box_bool();
+        default: return JIT_UNSUPPORTED;
+    }
+}
+
+/**
+ * @brief Arithmetic and comparisons on two ints or two floats. Mixed operands
+ *        convert in ways only the interpreter handles.
+ */
+static JitType compile_binary(ParseNode *node) {
+    JitType left = compile_node(node_left(node));
+    EMIT(PUSH_RAX);
+    JitType right = compile_node(node_right(node));
+    EMIT(POP_LEFT);
+
+    if (left != right) return JIT_UNSUPPORTED;
+    if (left == JIT_INT) return compile_int_op(generic_op(node->type));
+    if (left == JIT_FLOAT) return compile_float_op(generic_op(node->type));
+    return JIT_UNSUPPORTED;
+}
+
+static JitType compile_logical(ParseNode *node) {
+    bool is_and = node->type == OP_AND;
+
+    if (!emit_test(compile_node(node_left(node)))) return JIT_UNSUPPORTED;
+    size_t left_decides = is_and ? EMIT_JUMP(JZ) : EMIT_JUMP(JNZ);
+    if (!emit_test(compile_node(node_right(node)))) return JIT_UNSUPPORTED;
+    size_t right_decides = is_and ? EMIT_JUMP(JZ) : EMIT_JUMP(JNZ);
+
+    emit_load(BOOL_VAL(is_and));
+    size_t end = EMIT_JUMP(JMP);
+    patch_jump(left_decides, buffer_length);
+    patch_jump(right_decides, buffer_length);
+    emit_load(BOOL_VAL(!is_and));
+    patch_jump(end, buffer_length);
+    return JIT_BOOL;
+}
+
+static JitType compile_not(ParseNode *node) {
+    if (!emit_test(compile_node(node_left(node)))) return JIT_UNSUPPORTED;
+    EMIT(SETE);
+    return emit_box_bool();
+}
+
+static JitType compile_if(ParseNode *node) {
+    if (node_right(node) == NULL || node_left(node_right(node)) == NULL) return JIT_UNSUPPORTED;
+
+    if (!emit_test(compile_node(node_left(node)))) return JIT_UNSUPPORTED;
+    size_t skip = EMIT_JUMP(JZ);
+    JitType then = compile_node(node_left(node_right(node)));
+    size_t end = EMIT_JUMP(JMP);
+    patch_jump(skip, buffer_length);
+
+    JitType otherwise = JIT_ANY;
+    if (node_right(node_right(node)) != NULL) {
+        otherwise = compile_node(node_right(node_right(node)));
+    } else {
+        emit_load(NONE_VAL);
+    }
+    patch_jump(end, buffer_length);
+
+    if (then == JIT_UNSUPPORTED || otherwise == JIT_UNSUPPORTED) return JIT_UNSUPPORTED;
+    return then == otherwise ? then : JIT_ANY;
+}
+
+/**
+ * @brief Compile a while or for loop. The latest value of the body is kept on
+ *        the native stack and becomes the value of the loop.
+ * @param entry Whether this is the loop the region is entered at. It is
+ *        entered at its condition, with the latest value as the argument.
+ */
+static JitType compile_loop(ParseNode *node, bool entry) {
+    ParseNode *condition = node_left(node);
+    ParseNode *change = NULL;
+    if (node->type == FOR) {
+        if (node_left(node) == NULL || node_right(node_left(node)) == NULL) return JIT_UNSUPPORTED;
+        if (!entry && compile_node(node_left(node_left(node))) == JIT_UNSUPPORTED) return JIT_UNSUPPORTED;
+        condition = node_left(node_right(node_left(node)));
+        change = node_right(node_right(node_left(node)));
+    }
+
+    if (entry) {
+        EMIT(PUSH_LAST);
+    } else {
+        emit_load(NONE_VAL);
+        EMIT(PUSH_RAX);
+    }
+
+    size_t start = buffer_length;
+    if (!emit_test(compile_node(condition))) return JIT_UNSUPPORTED;
+    size_t exit = EMIT_JUMP(JZ);
+    if (compile_node(node_right(node)) == JIT_UNSUPPORTED) return JIT_UNSUPPORTED;
+    EMIT(STORE_LAST);
+    if (change != NULL && compile_node(change) == JIT_UNSUPPORTED) return JIT_UNSUPPORTED;
+    patch_jump(EMIT_JUMP(JMP), start);
+    patch_jump(exit, buffer_length);
+
+    EMIT(POP_RAX);
+    return JIT_ANY;
+}
+
+static JitType compile_statement_list(ParseNode *node) {
+    if (node->item_count == 0) {
+        emit_load(NONE_VAL);
+        return JIT_ANY;
+    }
+
+    // No return can be compiled, so every statement runs and the last one
+    // gives the value
+    JitType type = JIT_ANY;
+    for (int i = 0; i < node->item_count; i++) {
+        type = compile_node(node_item(node, i));
+        if (type == JIT_UNSUPPORTED) return JIT_UNSUPPORTED;
+    }
+    return type;
+}
+
+static JitType compile_assignment(ParseNode *node) {
+    ParseNode *target = node_left(node);
+    if (target == NULL || target->type != IDENTIFIER) return JIT_UNSUPPORTED;
+
+    // The slot keeps its type, so the guards checked on entry hold throughout
+    JitType type = slot_type(target);
+    if (type != JIT_INT && type != JIT_FLOAT) return JIT_UNSUPPORTED;
+    if (compile_node(node_right(node)) != type) return JIT_UNSUPPORTED;
+
+    EMIT(STORE_SLOT);
+    emit_u32((uint32_t)target->slot * sizeof(Value));
+    return type;
+}
+
+static JitType compile_identifier(ParseNode *node) {
+    JitType type = slot_type(node);
+    if (type != JIT_INT && type != JIT_FLOAT) return JIT_UNSUPPORTED;
+
+    EMIT(LOAD_SLOT);
+    emit_u32((uint32_t)node->slot * sizeof(Value));
+    return type;
+}
+
+static JitType compile_literal(ParseNode *node) {
+    Value value = node_literal(node);
+    emit_load(value);
+    if (IS_FLOAT(value)) return JIT_FLOAT;
+    if (IS_INT(value)) return JIT_INT;
+    if (IS_BOOL(value)) return JIT_BOOL;
+    if (IS_NONE(value)) return JIT_ANY;
+    return JIT_UNSUPPORTED;
+}
+
+/**
+ * @brief Emit the code of a node, leaving its value in rax.
+ * @return The type of the value, JIT_UNSUPPORTED if the node or one of its
+ *         children can only be interpreted.
+ */
+static JitType compile_node(ParseNode *node) {
+    if (node == NULL) return JIT_UNSUPPORTED;
+
+    switch (node->type) {
+        case LITERAL: return compile_literal(node);
+        case IDENTIFIER: return compile_identifier(node);
+        case ASSIGNMENT: return compile_assignment(node);
+        case STATEMENT_LIST: return compile_statement_list(node);
+        case WHILE: case FOR: return compile_loop(node, false);
+        case IF: case TERN_IF: return compile_if(node);
+        case OP_AND: case OP_OR: return compile_logical(node);
+        case OP_NOT: return compile_not(node);
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_GT: case OP_GTE: case OP_LT: case OP_LTE:
+        case OP_EQ: case OP_NEQ:
+        case OP_ADD_INT: case OP_SUB_INT: case OP_MUL_INT: case OP_DIV_INT: case OP_MOD_INT:
+        case OP_GT_INT: case OP_GTE_INT: case OP_LT_INT: case OP_LTE_INT:
+        case OP_EQ_INT: case OP_NEQ_INT:
+        case OP_ADD_FLOAT: case OP_SUB_FLOAT: case OP_MUL_FLOAT: case OP_DIV_FLOAT:
+        case OP_GT_FLOAT: case OP_GTE_FLOAT: case OP_LT_FLOAT: case OP_LTE_FLOAT:
+            return compile_binary(node);
+        default:
+            return JIT_UNSUPPORTED;
+    }
+}
+
+/**
+ * @brief Compile a loop or function body for the frame it is about to run in
+ *        and map the code executable.
+ * @return false if the region uses anything that has to be interpreted.
+ */
+static bool compile_region(Region *region, StackFrame *frame) {
+    if (frame->scope == NULL) return false;
+
+    region->scope = frame->scope;
+    region->slot_types = calloc(frame->scope->count + 1, sizeof(uint8_t));
+    if (!region->slot_types) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    compiling = region;
+    live_slots = frame->slots;
+    buffer_length = 0;
+
+    ParseNode *node = region->node;
+    bool is_loop = node->type == WHILE || node->type == FOR;
+    JitType type = is_loop ? compile_loop(node, true) : compile_node(node_right(node));
+    if (type == JIT_UNSUPPORTED) return false;
+    EMIT(RET);
+
+    void *memory = mmap(NULL, buffer_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return false;
+    memcpy(memory, buffer, buffer_length);
+    if (mprotect(memory, buffer_length, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, buffer_length);
+        return false;
+    }
+
+    region->code = (NativeCode)memory;
+    region->code_size = buffer_length;
+    return true;
+}
+
+static void discard_code(Region *region) {
+    if (region->code != NULL) {
+        munmap((void *)region->code, region->code_size);
+        region->code = NULL;
+    }
+    free(region->slot_types);
+    region->slot_types = NULL;
+}
+
+/**
+ * @brief Check that every slot the code uses still has the type it was
+ *        compiled for. Slots only change type outside compiled code.
+ */
+static bool guards_hold(Region *region, StackFrame *frame) {
+    if (frame->scope != region->scope) return false;
+
+    for (int i = 0; i < region->scope->count; i++) {
+        Value value = frame->slots[i];
+        switch (region->slot_types[i]) {
+            case JIT_INT: if (!IS_INT(value)) return false; break;
+            case JIT_FLOAT: if (!IS_FLOAT(value)) return false; break;
+            default: break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Count an entry into a region and run its code if it has any.
+ */
+static bool run_region(ParseNode *node, StackFrame *frame, int threshold, Value *value) {
+    Region *region = find_region(node);
+    if (region->state == REGION_FAILED) return false;
+
+    // A region that turns hot is compiled, then run straight away
+    if (region->state == REGION_COUNTING) {
+        if (++region->count < threshold) return false;
+        region->count = 0;
+        region->compilations++;
+        if (!compile_region(region, frame)) {
+            discard_code(region);
+            region->state = REGION_FAILED;
+            return false;
+        }
+        region->state = REGION_COMPILED;
+    }
+
+    if (!guards_hold(region, frame)) {
+        // Deoptimise: this run is interpreted, and code whose guards
+        // keep failing is thrown away to be compiled again for the
+        // types the region has now
+        if (++region->count >= JIT_MAX_GUARD_FAILURES) {
+            discard_code(region);
+            region->count = 0;
+            region->state = region->compilations < JIT_MAX_COMPILATIONS ? REGION_COUNTING : REGION_FAILED;
+        }
+        return false;
+    }
+    *value = region->code(frame->slots, *value);
+    return true;
+}
+
+#else
+
+static bool run_region(ParseNode *node, StackFrame *frame, int threshold, Value *value) {
+    return false;
+}
+
+static void discard_code(Region *region) {}
+
+#endif
+
+bool jit_loop(ParseNode *loop, Value *last) {
+    return run_region(loop, stack_peek(callStack), JIT_HOT_LOOP, last);
+}
+
+bool jit_call(ParseNode *definition, StackFrame *frame, Value *result) {
+    *result = NONE_VAL;
+    return run_region(definition, frame, JIT_HOT_CALLS, result);
+}
+
+void jit_free_all() {
+    for (size_t i = 0; i < region_capacity; i++) {
+        if (regions[i].node != NULL) {
+            discard_code(&regions[i]);
+        }
+    }
+    free(regions);
+    regions = NULL;
+    region_capacity = 0;
+    region_count = 0;
+
+#if JIT_SUPPORTED
+    free(buffer);
+    buffer = NULL;
+    buffer_length = 0;
+    buffer_capacity = 0;
+#endif
+}
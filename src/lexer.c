@@ -6,146 +6,210 @@
 #include <ctype.h>
 #include "token.h"
 #include "lexer.h"
+#include "utils/intern.h"
 
-static char advance();
-static char peek();
-static bool match(char c);
+#define INITIAL_TOKEN_CAPACITY 64
 
-int start = 0, current = 0;
-int line = 1;
+static Token make_token(Lexer *lexer, TokenType type) {
+    Token token;
+    token.category = type;
+    token.line = lexer->line;
+    token.start = lexer->source + lexer->start;
+    token.length = lexer->current - lexer->start;
+    token.text = NULL;
+    return token;
+}
 
-Token *tokens;
-int token_count;
-char *source;
+static char peek(Lexer *lexer) {
+    return lexer->source[lexer->current];
+}
 
-Token* tokenize(char *input, int *max_token_count) {
-    source = input; 
-    start = 0;
-    current = 0;
-    token_count = 0;
+static char advance(Lexer *lexer) {
+    return lexer->source[lexer->current++];
+}
 
-    tokens = malloc(*max_token_count * sizeof(Token));
-    if (!tokens) return NULL;
+static bool match(Lexer *lexer, char c) {
+    if (c != lexer->source[lexer->current]) { return false; }
+
+    lexer->current++;
+    return true;
+}
+
+static void lexer_error(Lexer *lexer, char *message) {
+    printf("\nSyntax Error: %s on line %d\n", message, lexer->line);
+}
+
+static Token number(Lexer *lexer) {
+    TokenType type = LITERAL;
+    while (isDigit(peek(lexer))) advance(lexer);
+
+    if (match(lexer, '.')) {
+        type = FLOAT;
+        while (isDigit(peek(lexer))) advance(lexer);
+    }
+
+    return make_token(lexer, type);
+}
+
+static Token identifier(Lexer *lexer) {
+    while (isAlphaNumeric(peek(lexer))) advance(lexer);
+
+    Token token = make_token(lexer, IDENTIFIER);
+    token.category = check_keyword(token.start, token.length);
+    if (token.category == IDENTIFIER) {
+        token.text = intern(token.start, token.length);
+    }
+    return token;
+}
+
+static Token string(Lexer *lexer) {
+    int line = lexer->line;
+    while (peek(lexer) != '"' && peek(lexer) != '\0') {
+        if (peek(lexer) == '\n') lexer->line++;
+        advance(lexer);
+    }
+
+    if (peek(lexer) == '\0') {
+        lexer_error(lexer, "Unterminated string");
+    }
+
+    Token token = make_token(lexer, STRING);
+    token.text = intern(token.start + 1, lexer->current - lexer->start - 1);
+    token.line = line;
+    match(lexer, '"');
+    return token;
+}
+
+/**
+ * @brief Prepare a lexer to scan a source from its first character.
+ * @param lexer The lexer to initialise.
+ * @param source The null terminated source, which must outlive the lexer.
+ */
+void lexer_init(Lexer *lexer, const char *source) {
+    lexer->source = source;
+    lexer->start = 0;
+    lexer->current = 0;
+    lexer->line = 1;
+}
+
+/**
+ * @brief Scan the next token of the source.
+ * @param lexer The lexer to read from.
+ * @param token Set to the token read. It points into the source, and the
+ *        text of an identifier or string is interned.
+ * @return false once the end of the source is reached.
+ */
+bool lexer_next(Lexer *lexer, Token *token) {
+    while (peek(lexer) != '\0') {
+        lexer->start = lexer->current; // mark start of token
+        char c = advance(lexer);
+        TokenType type;
 
-    while (source[current] != '\0') {
-        start = current; // mark start of token
-        char c = advance();
         switch (c) {
-            case '+': add_token(match('=') ? OP_ADD_EQUALS : match('+') ? OP_ADD_ADD : OP_ADD); break;
-            case '-': add_token(match('=') ? OP_SUB_EQUALS : match('-') ? OP_SUB_SUB : OP_SUB); break;
-            case '*': add_token(match('=') ? OP_MUL_EQUALS : OP_MUL); break;
-            case '/':     
-                if (match('/')) {
+            case '+': type = match(lexer, '=') ? OP_ADD_EQUALS : match(lexer, '+') ? OP_ADD_ADD : OP_ADD; break;
+            case '-': type = match(lexer, '=') ? OP_SUB_EQUALS : match(lexer, '-') ? OP_SUB_SUB : OP_SUB; break;
+            case '*': type = match(lexer, '=') ? OP_MUL_EQUALS : OP_MUL; break;
+            case '/':
+                if (match(lexer, '/')) {
                     // Just ignore whole line of comment
-                    while (peek() != '\n' && peek() != '\0') advance();
-                } else {
-                    add_token(match('=') ? OP_DIV_EQUALS : OP_DIV);
-                } 
+                    while (peek(lexer) != '\n' && peek(lexer) != '\0') advance(lexer);
+                    continue;
+                }
+                type = match(lexer, '=') ? OP_DIV_EQUALS : OP_DIV;
                 break;
-            case '%': add_token(OP_MOD); break; 
+            case '%': type = OP_MOD; break;
 
             case '&':
-                if (match('&')) {
-                    add_token(OP_AND);
-                } else {
-                    syntax_error("Unexpected single &");
+                if (!match(lexer, '&')) {
+                    lexer_error(lexer, "Unexpected single &");
+                    continue;
                 }
+                type = OP_AND;
                 break;
             case '|':
-                if (match('|')) {
-                    add_token(OP_OR);
-                } else {
-                    syntax_error("Unexpected single |");
+                if (!match(lexer, '|')) {
+                    lexer_error(lexer, "Unexpected single |");
+                    continue;
                 }
+                type = OP_OR;
                 break;
-            case '!': add_token(match('=') ? OP_NEQ : OP_NOT); break;
-
-            case '>': add_token(match('=') ? OP_GTE : match('>') ? OUT : OP_GT); break;
-            case '<': add_token(match('=') ? OP_LTE : match('<') ? IN : OP_LT); break;
-
-            case '=': add_token(match('=') ? OP_EQ : match('>') ? FUNCTION : ASSIGNMENT); break;
-            case '.': add_token(OP_DOT); break;
-            case ';': add_token(SEPERATOR); break;
-            case '?': add_token(TERN_IF); break;
-            case ':': add_token(COLON); break;
-            case '(': add_token(PAREN_L); break;
-            case ')': add_token(PAREN_R); break;
-            case '{': add_token(BRACES_L); break;
-            case '}': add_token(BRACES_R); break;
-            case '[': add_token(SQUARE_L); break;
-            case ']': add_token(SQUARE_R); break;
-            case ',': add_token(COMMA); break;
-            case '"': string(); break;
-            case '\n': line++; break;
+            case '!': type = match(lexer, '=') ? OP_NEQ : OP_NOT; break;
+
+            case '>': type = match(lexer, '=') ? OP_GTE : match(lexer, '>') ? OUT : OP_GT; break;
+            case '<': type = match(lexer, '=') ? OP_LTE : match(lexer, '<') ? IN : OP_LT; break;
+
+            case '=': type = match(lexer, '=') ? OP_EQ : match(lexer, '>') ? FUNCTION : ASSIGNMENT; break;
+            case '.': type = OP_DOT; break;
+            case ';': type = SEPERATOR; break;
+            case '?': type = TERN_IF; break;
+            case ':': type = COLON; break;
+            case '(': type = PAREN_L; break;
+            case ')': type = PAREN_R; break;
+            case '{': type = BRACES_L; break;
+            case '}': type = BRACES_R; break;
+            case '[': type = SQUARE_L; break;
+            case ']': type = SQUARE_R; break;
+            case ',': type = COMMA; break;
+            case '"': *token = string(lexer); return true;
+            case '\n': lexer->line++; continue;
             default:
                 if (isDigit(c)) {
-                    number();
+                    *token = number(lexer);
+                    return true;
                 } else if (isAlpha(c)) {
-                    identifier();
+                    *token = identifier(lexer);
+                    return true;
                 }
-                break;
+                continue;
         }
-    }
-
-    *max_token_count = token_count;
-    return tokens;
-}
-
-static char peek() {
-    return source[current];
-}
 
-void add_token(TokenType type) {
-    tokens[token_count].category = type;
-    tokens[token_count].text = substring(source, start, current - 1);
-    tokens[token_count].line = line;
-    token_count++;
-}
-
-void add_token_string(TokenType type, char* text) {
-    tokens[token_count].category = type;
-    tokens[token_count].text = text;
-    tokens[token_count].line = line;
-    token_count++;
-}
+        *token = make_token(lexer, type);
+        return true;
+    }
 
-static char advance() {
-    return source[current++];
+    return false;
 }
 
-static bool match(char c) {
-    if (c != source[current]) { return false; }
-
-    current++;
-    return true;
-}
+/**
+ * @brief Scan a whole source into an array of tokens. The array grows by
+ *        doubling, and is followed by two zeroed tokens with a NONE category
+ *        so the parser can look ahead past the last token.
+ * @param input The null terminated source.
+ * @param token_count Set to the number of tokens read.
+ * @return The tokens, freed with free_tokens().
+ */
+Token* tokenize(const char *input, int *token_count) {
+    Lexer lexer;
+    lexer_init(&lexer, input);
 
-void number() {
-    TokenType type = LITERAL;
-    while (isDigit(peek())) advance();
+    int count = 0;
+    int capacity = INITIAL_TOKEN_CAPACITY;
+    Token *tokens = malloc(capacity * sizeof(Token));
+    if (!tokens) return NULL;
 
-    if (match('.')) {
-        type = FLOAT;
-        while (isDigit(peek())) advance();
+    Token token;
+    while (lexer_next(&lexer, &token)) {
+        if (count + 3 > capacity) {
+            capacity *= 2;
+            Token *grown = realloc(tokens, capacity * sizeof(Token));
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            tokens = grown;
+        }
+        tokens[count++] = token;
     }
 
-    add_token_string(type, substring(source, start, current - 1));
-}
-
-void identifier() {
-    while (isAlphaNumeric(peek())) advance();
-
-    char *text = substring(source, start, current - 1);
-    TokenType type = check_keyword(text);
-    add_token_string(type, text);
-}
+    // Sentinels so the parser can peek past the last token
+    memset(&tokens[count], 0, 2 * sizeof(Token));
+    tokens[count].category = NONE;
+    tokens[count].line = lexer.line;
+    tokens[count + 1].category = NONE;
+    tokens[count + 1].line = lexer.line;
 
-void string() {
-    while (peek()!='"') advance();
-
-    char *text = substring(source, start + 1, current - 1);
-    add_token_string(STRING, text);
-    advance();
+    *token_count = count;
+    return tokens;
 }
 
 bool isDigit(char c) {
@@ -173,39 +237,46 @@ char* substring(const char *input, int left, int right) {
 
 typedef struct {
     const char *name;
+    int length;
     TokenType type;
 } Keyword;
 
-Keyword keywords[] = {
-    {"if", IF},
-    {"else", ELSE},
-    {"while", WHILE},
-    {"for", FOR},
-    {"do", DO},
-    {"def", DEF},
-    {"class", CLASS},
-    {"set", SET},
-    {"return", RETURN},
-    {"true", TRUE},
-    {"false", FALSE},
-    {"import", IMPORT},
-    {NULL, 0}
+#define KEYWORD_HASH(str, length) (((unsigned char)(str)[0] + (unsigned char)(str)[(length) - 1] + 2 * (length)) & 31)
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 6
+
+/**
+ * Keywords placed by KEYWORD_HASH, which gives each of them its own slot so
+ * a lookup is one hash and one comparison. Regenerate the indices if a
+ * keyword is added.
+ */
+static const Keyword keywords[32] = {
+    [0]  = {"class", 5, CLASS},
+    [1]  = {"true", 4, TRUE},
+    [6]  = {"while", 5, WHILE},
+    [9]  = {"import", 6, IMPORT},
+    [12] = {"return", 6, RETURN},
+    [13] = {"set", 3, SET},
+    [16] = {"def", 3, DEF},
+    [18] = {"else", 4, ELSE},
+    [19] = {"if", 2, IF},
+    [21] = {"false", 5, FALSE},
+    [23] = {"do", 2, DO},
+    [30] = {"for", 3, FOR},
 };
 
-TokenType check_keyword(const char *str) {
-    for (int i = 0; keywords[i].name != NULL; i++) {
-        if (strcmp(str, keywords[i].name) == 0) {
-            return keywords[i].type;
-        }
+TokenType check_keyword(const char *str, int length) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return IDENTIFIER;
+
+    const Keyword *keyword = &keywords[KEYWORD_HASH(str, length)];
+    if (keyword->length == length && memcmp(str, keyword->name, length) == 0) {
+        return keyword->type;
     }
     return IDENTIFIER;
 }
 
 void free_tokens(Token *tokens, int count) {
-    for (int i = 0; i < count; i++) {
-        if (tokens[i].text) {
-            free(tokens[i].text);
-        }
-    }
+    // Token text is either in the source or interned, neither is owned here
+    (void)count;
     free(tokens);
 }
\ No newline at end of file
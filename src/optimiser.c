@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "token.h"
+#include "optimiser.h"
+#include "evaluator.h"
+#include "utils/intern.h"
+
+int optimisation_level = 1;
+Arena *optimiser_arena; // Arena of the tree being optimised
+
+void set_optimisation_level(int level) {
+    optimisation_level = level;
+}
+
+static bool is_literal(ParseNode *node) {
+    return node != NULL && node->type == LITERAL;
+}
+
+static bool is_numeric(Value value) {
+    return IS_INT(value) || IS_FLOAT(value) || IS_BOOL(value);
+}
+
+/**
+ * @brief Turn a node into a literal in place, dropping its operands.
+ * @return The node.
+ */
+static ParseNode *make_literal(ParseNode *node, Value value) {
+    node->type = LITERAL;
+    node->left = 0;
+    node->right = 0;
+    node->items = 0;
+    node->item_count = 0;
+    node_set_literal(node, value);
+    return node;
+}
+
+/**
+ * @brief Whether apply_op_binary() gives a result for these operands rather
+ *        than a runtime error. Only operands of the same type are folded, and
+ *        a division by zero is left to fail when the program runs.
+ */
+static bool can_fold_arithmetic(TokenType op, Value left, Value right) {
+    if (IS_INT(left) && IS_INT(right)) {
+        if (op == OP_DIV || op == OP_MOD) {
+            return AS_INT(right) != 0 && !(AS_INT(left) == INT_MIN && AS_INT(right) == -1);
+        }
+        return true;
+    }
+    if (IS_FLOAT(left) && IS_FLOAT(right)) {
+        return op != OP_MOD;
+    }
+    return false;
+}
+
+static Value concatenate_literals(Value left, Value right) {
+    size_t left_length = strlen(AS_STRING(left));
+    size_t right_length = strlen(AS_STRING(right));
+    char *chars = malloc(left_length + right_length + 1);
+    if (!chars) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(chars, AS_STRING(left), left_length);
+    memcpy(chars + left_length, AS_STRING(right), right_length);
+
+    char *text = intern(chars, left_length + right_length);
+    free(chars);
+    return string_literal_create(optimiser_arena, text);
+}
+
+static ParseNode *fold_binary(ParseNode *node) {
+    if (!is_literal(node_left(node)) || !is_literal(node_right(node))) return node;
+    Value left = node_literal(node_left(node));
+    Value right = node_literal(node_right(node));
+
+    if (node->type == OP_ADD && value_type(left) == TYPE_STRING && value_type(right) == TYPE_STRING) {
+        return make_literal(node, concatenate_literals(left, right));
+    }
+
+    switch (node->type) {
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_GT: case OP_GTE: case OP_LT: case OP_LTE:
+            if (can_fold_arithmetic(node->type, left, right)) {
+                return make_literal(node, apply_op_binary(node, left, right));
+            }
+            return node;
+        case OP_EQ: case OP_NEQ:
+            // Other heap values compare by identity, which is only known at runtime
+            if ((is_numeric(left) && is_numeric(right))
+                || (value_type(left) == TYPE_STRING && value_type(right) == TYPE_STRING)) {
+                return make_literal(node, apply_op_eq(node, left, right));
+            }
+            return node;
+        default:
+            return node;
+    }
+}
+
+/**
+ * @brief Fold && and || whose left operand is a constant, with the same
+ *        result evaluate_op_logical() would give.
+ */
+static ParseNode *fold_logical(ParseNode *node) {
+    if (!is_literal(node_left(node))) return node;
+
+    bool left = is_truthy(node_literal(node_left(node)));
+    if (node->type == OP_AND ? !left : left) {
+        return make_literal(node, BOOL_VAL(left));
+    }
+    if (is_literal(node_right(node))) {
+        return make_literal(node, BOOL_VAL(is_truthy(node_literal(node_right(node)))));
+    }
+    return node;
+}
+
+/**
+ * @brief Replace an if whose condition is a constant by the branch it takes.
+ */
+static ParseNode *prune_if(ParseNode *node) {
+    if (!is_literal(node_left(node))) return node;
+
+    ParseNode *branch = is_truthy(node_literal(node_left(node))) ? node_left(node_right(node)) : node_right(node_right(node));
+    if (branch == NULL) {
+        return make_literal(node, NONE_VAL);
+    }
+    return branch;
+}
+
+/**
+ * @brief Optimise the children of a node before the node itself, so folding
+ *        works from the leaves up.
+ * @return The node to use in place of the original one.
+ */
+static ParseNode *optimise_node(ParseNode *node) {
+    if (node == NULL || node->type == IMPORT) return node;
+
+    node_set_left(node, optimise_node(node_left(node)));
+    node_set_right(node, optimise_node(node_right(node)));
+    for (int i = 0; i < node->item_count; i++) {
+        node_store.items[node->items + i] = node_index(optimise_node(node_item(node, i)));
+    }
+
+    switch (node->type) {
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_GT: case OP_GTE: case OP_LT: case OP_LTE:
+        case OP_EQ: case OP_NEQ:
+            return fold_binary(node);
+        case OP_AND: case OP_OR:
+            return fold_logical(node);
+        case OP_NOT:
+            if (is_literal(node_left(node))) {
+                return make_literal(node, apply_op_not(node_literal(node_left(node))));
+            }
+            return node;
+        case IF: case TERN_IF:
+            return prune_if(node);
+        default:
+            return node;
+    }
+}
+
+void optimise_program(ParseNode *program, Arena *arena) {
+    if (optimisation_level == 0) return;
+
+    optimiser_arena = arena;
+    optimise_node(program);
+}
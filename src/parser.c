@@ -3,13 +3,14 @@
 #include <stdbool.h>
 #include <string.h>
 #include "token.h"
+#include "utils/arena.h"
 
 ParseNode *parse_expression();
 ParseNode *parse_block();
 ParseNode *parse_literal();
 ParseNode *parse_term();
-ParseNode *parse_increment_operator();
-ParseNode *add_child(ParseNode *parent, ParseNode *child);
+ParseNode *parse_datastructure();
+ParseNode *parse_increment_operator(ParseNode *identifier);
 ParseNode *create_node(TokenType type);
 ParseNode *create_node_with_children(TokenType op, ParseNode *left, ParseNode *right);
 
@@ -17,67 +18,32 @@ Token* input_tokens;
 int position;
 Token current_t;
 int count;
+Arena *node_arena; // Owns every node of the file being parsed
+
+// Children of every sequence still being parsed, innermost last
+ParseNode **pending;
+int pending_count;
+int pending_capacity;
 
 void syntax_error(char* string) {
     printf("\nSyntax Error: %s on line %d\n", string, input_tokens[position].line);
     if (position - 1 >= 0) {
-        printf("%s ", input_tokens[position - 1].text);
+        printf("%.*s ", input_tokens[position - 1].length, input_tokens[position - 1].start);
     }
     if (position < count) {
-        printf("_%s_ ", input_tokens[position].text);
+        printf("_%.*s_ ", input_tokens[position].length, input_tokens[position].start);
     }
     if (position + 1 < count) {
-        printf("%s ", input_tokens[position + 1].text);
+        printf("%.*s ", input_tokens[position + 1].length, input_tokens[position + 1].start);
     }
 
     printf("\n");
 }
 
 static void advance() {
-    current_t = input_tokens[++position];
-}
-
-static Token peek() {
-    return input_tokens[position + 1];
-} 
-
-static Token peek_past() {
-    int i = position + 1;
-    int depth = 0;
-
-    while (i < count) {
-        Token token = input_tokens[i];
-
-        if (token.category == SQUARE_L || token.category == PAREN_L) {
-            depth++;
-        } else if ((token.category == SQUARE_R || token.category == PAREN_R) && depth > 0) {
-            depth--;
-        } else if (depth == 0) {
-            return token;
-        }
-
-        i++;
-    }
-
-    // Somethings gone wrong
-    Token t = {0};
-    t.category = NONE;
-    return t;
-}
-
-static bool peek_match(TokenType match) {
-    return input_tokens[position + 1].category == match;
-}
-
-static bool precedes(TokenType a, TokenType b) {
-    int pos = position;
-    while (pos < count) {
-        TokenType type = input_tokens[pos].category;
-        if (type == a) return true;
-        if (type == b) return false;
-        pos++;
-    }
-    return false;
+    // Stop on the sentinel after the last token
+    if (position < count) position++;
+    current_t = input_tokens[position];
 }
 
 static bool previous_match(TokenType match) {
@@ -103,30 +69,61 @@ static bool match(TokenType match) {
     return current_t.category == match;
 }
 
-ParseNode *parse_args() {
-    ParseNode* root = NULL;
+/**
+ * @brief Queue a child of the sequence being parsed. Children go onto one
+ *        shared stack, so nested sequences never copy more than once.
+ * @param child The statement, element, pair or argument, skipped if NULL.
+ */
+static void push_item(ParseNode *child) {
+    if (child == NULL) return;
+
+    if (pending_count + 1 > pending_capacity) {
+        pending_capacity = pending_capacity < 64 ? 64 : pending_capacity * 2;
+        pending = realloc(pending, pending_capacity * sizeof(ParseNode*));
+        if (!pending) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    pending[pending_count++] = child;
+}
+
+/**
+ * @brief Move the children queued since first into the items of a node.
+ * @param node The sequence node.
+ * @param first The pending count when the sequence started.
+ */
+static void pop_items(ParseNode *node, int first) {
+    node_set_items(node, pending + first, pending_count - first);
+    pending_count = first;
+}
+
+/**
+ * @brief Parse the arguments of a call, or the parameters of a definition,
+ *        into the items of the identifier.
+ */
+void parse_args(ParseNode *identifier) {
+    int first = pending_count;
     expect(PAREN_L);
-    while (!match(PAREN_R)) {
-        ParseNode* node = parse_expression();
-        root = add_child(root, node);
+    while (!match(PAREN_R) && !match(NONE)) {
+        push_item(parse_expression());
         if (match(COMMA)) {
             advance();
         }
     }
     advance();
-    return root;
+    pop_items(identifier, first);
 }
 
 ParseNode *parse_identifier() {
     if (match(IDENTIFIER)) {
         ParseNode *node = create_node(IDENTIFIER);
-        node->value.data.stringValue = current_t.text;
+        node_set_name(node, current_t.text);
         advance();
 
         while (true) {
             if (match(PAREN_L)) {
-                ParseNode *args = parse_args();
-                node->right = args;
+                parse_args(node);
             } else if (match(SQUARE_L)) { // List access
                 expect(SQUARE_L);
                 ParseNode *index = parse_expression();
@@ -143,58 +140,81 @@ ParseNode *parse_identifier() {
     }
 }
 
+/**
+ * @brief Copy the characters of a number token so they can be converted.
+ *        Tokens point into the source, which is not terminated after them.
+ */
+static void number_text(Token token, char *buffer, int size) {
+    int length = token.length < size - 1 ? token.length : size - 1;
+    memcpy(buffer, token.start, length);
+    buffer[length] = '\0';
+}
+
 ParseNode *parse_literal() {
+    char number[64];
+
     if (match(LITERAL)) {
         ParseNode *node = create_node(LITERAL);
-        node->value.type = TYPE_INT;
-        node->value.data.intValue = atoi(current_t.text);
+        number_text(current_t, number, sizeof(number));
+        node_set_literal(node, INT_VAL(atoi(number)));
         advance();
         return node;
     } else if (match(FLOAT)) {
         ParseNode *node = create_node(LITERAL);
-        node->value.type = TYPE_FLOAT;
+        number_text(current_t, number, sizeof(number));
         char *end;
-        double d = strtod(current_t.text, &end);
-        if (end == current_t.text) {
+        double d = strtod(number, &end);
+        if (end == number) {
             syntax_error("Invalid literal");
         }
-        node->value.data.floatValue = d;
+        node_set_literal(node, FLOAT_VAL(d));
         advance();
         return node;
     } else if (match(STRING)) {
         ParseNode *node = create_node(LITERAL);
-        node->value.type = TYPE_STRING;
-        node->value.data.stringValue = current_t.text;
+        node_set_literal(node, string_literal_create(node_arena, current_t.text));
         advance();
         return node;
     } else if (match(TRUE) || match(FALSE)) {
         ParseNode *node = create_node(LITERAL);
-        node->value.type = TYPE_BOOL;
-        if (match(TRUE)) {
-            node->value.data.intValue = 1;
-        } else {
-            node->value.data.intValue = 0;
-        }
+        node_set_literal(node, BOOL_VAL(match(TRUE)));
         advance();
         return node;
     } else {
         syntax_error("Expected Literal");
+        advance(); // Skip the token so parsing can continue
         return NULL;
     }
 }
 
+/**
+ * @brief Parse an operand: a literal, a list or map, a negation, a bracketed
+ *        expression, or an identifier with its calls, indexing and increment.
+ */
 ParseNode *parse_term() {
-    if (peek_match(OP_ADD_ADD) || peek_match(OP_SUB_SUB)) {
-        return parse_increment_operator();
-    }
     if (match(OP_NOT)) {
         advance();
         ParseNode *not = create_node(OP_NOT);
-        not->left = parse_term();
+        node_set_left(not, parse_term());
         return not;
     }
+    else if (match(SQUARE_L)) {
+        return parse_datastructure();
+    }
+    else if (match(PAREN_L)) {
+        advance();
+        ParseNode *node = parse_expression();
+        expect(PAREN_R);
+        return node;
+    }
     else if (match(IDENTIFIER)) {
-        return parse_identifier();
+        // Only a bare name can be incremented, so check before any call or index
+        TokenType next = input_tokens[position + 1].category;
+        ParseNode *identifier = parse_identifier();
+        if (next == OP_ADD_ADD || next == OP_SUB_SUB) {
+            return parse_increment_operator(identifier);
+        }
+        return identifier;
     }
     return parse_literal();
 }
@@ -266,17 +286,15 @@ ParseNode *parse_function_definition() {
 /**
  * @brief Convert x++ to x+=1
  */
-ParseNode *parse_increment_operator() {
-    ParseNode* identifier = parse_identifier();
+ParseNode *parse_increment_operator(ParseNode *identifier) {
     TokenType operator_type = current_t.category - 2;
     advance();
 
     ParseNode* right = create_node(LITERAL);
-    right->value.type = TYPE_INT;
-    right->value.data.intValue = 1;
+    node_set_literal(right, INT_VAL(1));
 
     ParseNode *identifier_copy = create_node(IDENTIFIER);
-    identifier_copy->value.data.stringValue = strdup(identifier->value.data.stringValue);
+    node_set_name(identifier_copy, node_name(identifier));
 
     ParseNode *operator = create_node_with_children(operator_type, identifier_copy, right);
     ParseNode *assignment = create_node_with_children(ASSIGNMENT, identifier, operator);
@@ -287,14 +305,13 @@ ParseNode *parse_increment_operator() {
 /**
  * @brief Converts input like x += 1 to x = x + 1
  */
-ParseNode *parse_compound_assignment_operator() {
-    ParseNode *identifier = parse_identifier();
+ParseNode *parse_compound_assignment_operator(ParseNode *identifier) {
     TokenType operator_type = current_t.category - 1;
     advance();
     ParseNode* right = parse_expression();
 
     ParseNode *identifier_copy = create_node(IDENTIFIER);
-    identifier_copy->value.data.stringValue = identifier->value.data.stringValue;
+    node_set_name(identifier_copy, node_name(identifier));
 
     ParseNode *operator = create_node_with_children(operator_type, identifier_copy, right);
     ParseNode *assignment = create_node_with_children(ASSIGNMENT, identifier, operator);
@@ -316,9 +333,12 @@ int op_precedence(TokenType token) {
     }
 }
 
-ParseNode *parse_op_binary(int min_precedence) {
-    ParseNode *node = parse_term();
-
+/**
+ * @brief Precedence climbing over binary operators, all left associative.
+ * @param left The operand already parsed.
+ * @param min_precedence The lowest precedence this call may consume.
+ */
+ParseNode *parse_op_binary(ParseNode *left, int min_precedence) {
     while (true) {
         int prec = op_precedence(current_t.category);
         if (prec < min_precedence) break;
@@ -326,19 +346,19 @@ ParseNode *parse_op_binary(int min_precedence) {
         TokenType op = current_t.category;
         advance();
 
-        ParseNode *right = parse_op_binary(prec + 1);
+        ParseNode *right = parse_op_binary(parse_term(), prec + 1);
 
-        node = create_node_with_children(op, node, right);
+        left = create_node_with_children(op, left, right);
     }
 
-    return node;
+    return left;
 }
 
 ParseNode *parse_return() {
     expect(RETURN);
     ParseNode *node = create_node(RETURN);
     ParseNode* left = parse_expression();
-    node->left = left;
+    node_set_left(node, left);
     return node;
 }
 
@@ -346,7 +366,7 @@ ParseNode *parse_out() {
     expect(OUT);
     ParseNode *node = create_node(OUT);
     ParseNode* left = parse_expression();
-    node->left = left;
+    node_set_left(node, left);
     return node;
 }
 
@@ -355,60 +375,81 @@ ParseNode *parse_in() {
     return create_node(IN);
 }
 
-ParseNode *parse_pair() {
-    ParseNode *key = parse_expression();
+ParseNode *parse_pair_value(ParseNode *key) {
     expect(COLON);
     ParseNode *value = parse_expression();
-    ParseNode *pair = create_node_with_children(COLON, key, value);
-    return create_node_with_children(CONTROL, pair, NULL);
+    return create_node_with_children(COLON, key, value);
 }
 
-ParseNode *parse_map() {
-    expect(SQUARE_L);
+/**
+ * @brief Parse the rest of a map once its first key is known.
+ */
+ParseNode *parse_map(ParseNode *first_key) {
     ParseNode *map = create_node(MAP);
+    int first = pending_count;
+    push_item(parse_pair_value(first_key));
+    if (match(COMMA)) advance();
 
-    if (match(COLON)) {
-        advance();
-    } else {
-        while(!match(SQUARE_R)) {
-            ParseNode *pair = parse_pair();
-            add_child(map, pair);
-            if (match(COMMA)) advance();
-        }
+    while(!match(SQUARE_R) && !match(NONE)) {
+        push_item(parse_pair_value(parse_expression()));
+        if (match(COMMA)) advance();
     }
 
     expect(SQUARE_R);
+    pop_items(map, first);
 
     return map;
 }
 
-ParseNode *parse_list() {
-    expect(SQUARE_L);
+/**
+ * @brief Parse the rest of a list once its first element is known.
+ */
+ParseNode *parse_list(ParseNode *first) {
     ParseNode *list = create_node(LIST);
+    int first_item = pending_count;
+    push_item(first);
+    if (match(COMMA)) advance();
 
-    while(!match(SQUARE_R)) {
-        add_child(list, parse_expression());
+    while(!match(SQUARE_R) && !match(NONE)) {
+        push_item(parse_expression());
         if (match(COMMA)) advance();
     }
 
     expect(SQUARE_R);
+    pop_items(list, first_item);
 
     return list;
 }
 
+/**
+ * @brief Parse a list or a map. A colon after the first element is what
+ *        makes it a map, [:] is the empty map.
+ */
 ParseNode *parse_datastructure() {
-    if (precedes(COLON, SQUARE_R)) {
-        return parse_map();
-    } else {
-        return parse_list();
+    expect(SQUARE_L);
+
+    if (match(COLON)) {
+        advance();
+        expect(SQUARE_R);
+        return create_node(MAP);
+    }
+    if (match(SQUARE_R)) {
+        advance();
+        return create_node(LIST);
+    }
+
+    ParseNode *first = parse_expression();
+    if (match(COLON)) {
+        return parse_map(first);
     }
+    return parse_list(first);
 }
 
 ParseNode *parse_import() {
     expect(IMPORT);
     ParseNode *import = create_node(IMPORT);
     ParseNode *filename = parse_literal();
-    import->left = filename;
+    node_set_left(import, filename);
 
     return import;
 }
@@ -425,16 +466,13 @@ ParseNode *parse_set() {
     return set;
 }
 
-ParseNode *parse_assignment() {
-    ParseNode* left = parse_term();
+ParseNode *parse_assignment(ParseNode *left) {
     expect(ASSIGNMENT);
     ParseNode *assignment = create_node(ASSIGNMENT);
-    assignment->value.type = TYPE_METADATA;
-    assignment->value.data.stringValue = strdup(current_t.text);
     ParseNode* right = parse_expression();
 
-    assignment->left = left;
-    assignment->right = right;
+    node_set_left(assignment, left);
+    node_set_right(assignment, right);
 
     return assignment;
 }
@@ -448,44 +486,31 @@ ParseNode *parse_expression() {
         case WHILE:    return parse_while();
         case FOR:      return parse_for();
         case IF:       return parse_if();
-        case SQUARE_L: return parse_datastructure();
         case IN:       return parse_in();
         case OUT:      return parse_out();
         case RETURN:   return parse_return();
     }
 
-    if (peek_past().category == ASSIGNMENT) {
-        return parse_assignment();
-    } else if (is_compound_assignment_operator(peek().category)) {
-        return parse_compound_assignment_operator();
-    } else if (is_operator(peek_past().category)) {
-        // All operators with precedence climbing
-        return parse_op_binary(0);
-    } else {
-        return parse_term();
-    }
-}
-
-ParseNode *add_child(ParseNode *parent, ParseNode *child) {
-    if (parent == NULL) return child;  // return new root
+    // The token after the first operand decides what the expression is
+    ParseNode *left = parse_term();
 
-    ParseNode *cur = parent;
-    while (cur->right != NULL) {
-        cur = cur->right;
+    if (match(ASSIGNMENT)) {
+        return parse_assignment(left);
+    } else if (is_compound_assignment_operator(current_t.category) && left && left->type == IDENTIFIER && !previous_match(PAREN_R)) {
+        return parse_compound_assignment_operator(left);
+    } else {
+        // All operators with precedence climbing
+        return parse_op_binary(left, 0);
     }
-    cur->right = child;
-    return parent;
 }
 
 ParseNode *parse_block() {
     if(match(BRACES_L)) {
         expect(BRACES_L);
         ParseNode *root = create_node(STATEMENT_LIST);
-        while (!match(BRACES_R)) {
-            ParseNode *node = create_node(STATEMENT_LIST);
-            ParseNode *expr = parse_expression();
-            node->left = expr;
-            root = add_child(root, node);
+        int first = pending_count;
+        while (!match(BRACES_R) && !match(NONE)) {
+            push_item(parse_expression());
 
             if (match(SEPERATOR)) {
                 advance();
@@ -494,6 +519,7 @@ ParseNode *parse_block() {
             }
         }
         expect(BRACES_R);
+        pop_items(root, first);
         return root;
     } else {
         ParseNode *node = parse_expression();
@@ -508,35 +534,40 @@ ParseNode *parse_block() {
 
 ParseNode *parse_program() {
     ParseNode *root = create_node(PROGRAM);
+    int first = pending_count;
 
     while (position < count) {
-        ParseNode *node = create_node(STATEMENT_LIST);
-        ParseNode *expr = parse_block();
-        node->left = expr;
-        root = add_child(root, node);
+        push_item(parse_block());
     }
 
+    pop_items(root, first);
     return root;
 }
 
-ParseNode *parse(Token *input, int size) {
+ParseNode *parse(Token *input, int size, Arena *arena) {
+    node_arena = arena;
     input_tokens = input;
     count = size;
     position = 0;
     current_t = input_tokens[position];
 
-    return parse_program();
+    ParseNode *program = parse_program();
+
+    free(pending);
+    pending = NULL;
+    pending_count = pending_capacity = 0;
+    return program;
 }
 
 ParseNode *create_node(TokenType type) {
-    ParseNode *node = parse_node_create(type);
+    ParseNode *node = parse_node_create(node_arena, type);
     node->line = current_t.line;
     return node;
 }
 
 ParseNode *create_node_with_children(TokenType op, ParseNode *left, ParseNode *right) {
     ParseNode *new_node = create_node(op);
-    new_node->left = left;
-    new_node->right = right;
+    node_set_left(new_node, left);
+    node_set_right(new_node, right);
     return new_node;
 }
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "token.h"
+#include "resolver.h"
+#include "utils/intern.h"
+
+static void resolve_node(ParseNode *node, Scope *scope);
+
+Scope *globals;
+
+// Names some frame reads by searching the call stack, so frames below it may bind them
+static Scope *read_by_name = NULL;
+static bool has_import = false;
+
+// Function scopes of the program being resolved, whose privacy is decided at the end
+static Scope **function_scopes = NULL;
+static int function_count = 0;
+static int function_capacity = 0;
+
+Scope *scope_create() {
+    Scope *scope = calloc(1, sizeof(Scope));
+    if (!scope) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return scope;
+}
+
+/**
+ * @brief Find the slot of a name.
+ * @param scope The scope to search.
+ * @param name The interned variable name.
+ * @return The slot index, or -1 if the name is not bound in the scope.
+ */
+int scope_find(Scope *scope, const char *name) {
+    if (!scope || scope->index_capacity == 0) return -1;
+
+    unsigned int mask = scope->index_capacity - 1;
+    for (unsigned int pos = SYMBOL_HASH(name) & mask; scope->index[pos] != -1; pos = (pos + 1) & mask) {
+        if (scope->names[scope->index[pos]] == name) {
+            return scope->index[pos];
+        }
+    }
+    return -1;
+}
+
+static void index_insert(Scope *scope, int slot) {
+    unsigned int mask = scope->index_capacity - 1;
+    unsigned int pos = SYMBOL_HASH(scope->names[slot]) & mask;
+    while (scope->index[pos] != -1) {
+        pos = (pos + 1) & mask;
+    }
+    scope->index[pos] = slot;
+}
+
+/**
+ * @brief Give a name the next free slot of a scope, unless it has one.
+ * @return The slot of the name.
+ */
+int scope_declare(Scope *scope, char *name) {
+    int slot = scope_find(scope, name);
+    if (slot >= 0) return slot;
+
+    if (scope->count + 1 > scope->capacity) {
+        scope->capacity = scope->capacity < 8 ? 8 : scope->capacity * 2;
+        scope->names = realloc(scope->names, scope->capacity * sizeof(char*));
+        scope->shadowed = realloc(scope->shadowed, scope->capacity * sizeof(bool));
+        if (!scope->names || !scope->shadowed) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    slot = scope->count++;
+    scope->names[slot] = name;
+    scope->shadowed[slot] = false;
+
+    // Keep the index at most half full
+    if (scope->count * 2 > scope->index_capacity) {
+        free(scope->index);
+        scope->index_capacity = scope->index_capacity < 16 ? 16 : scope->index_capacity * 2;
+        scope->index = malloc(scope->index_capacity * sizeof(int));
+        if (!scope->index) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        memset(scope->index, -1, scope->index_capacity * sizeof(int));
+        for (int i = 0; i < scope->count; i++) {
+            index_insert(scope, i);
+        }
+    } else {
+        index_insert(scope, slot);
+    }
+    return slot;
+}
+
+void scope_destroy(Scope *scope) {
+    if (!scope) return;
+    free(scope->names);
+    free(scope->shadowed);
+    free(scope->index);
+    free(scope);
+}
+
+/**
+ * @brief Record that a name can be bound in a frame above main, so reads of
+ *        the global from other functions have to search the call stack.
+ */
+static void mark_shadowed(const char *name) {
+    int slot = scope_find(globals, name);
+    if (slot >= 0) {
+        globals->shadowed[slot] = true;
+    }
+}
+
+static void declare(Scope *scope, char *name) {
+    if (scope != globals) {
+        mark_shadowed(name);
+    }
+    if (scope != NULL) {
+        scope_declare(scope, name);
+    }
+}
+
+/**
+ * @brief Declare every name bound directly in a body. Nested function and
+ *        class bodies are skipped as they run in frames of their own.
+ */
+static void collect(ParseNode *node, Scope *scope) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case ASSIGNMENT:
+            if (node_left(node) && node_left(node)->type == IDENTIFIER) {
+                declare(scope, node_name(node_left(node)));
+            } else {
+                collect(node_left(node), scope);
+            }
+            collect(node_right(node), scope);
+            break;
+        case FUNCTION:
+        case CLASS:
+            declare(scope, node_name(node_left(node)));
+            break;
+        case IMPORT:
+            break;
+        default:
+            collect(node_left(node), scope);
+            collect(node_right(node), scope);
+            for (int i = 0; i < node->item_count; i++) {
+                collect(node_item(node, i), scope);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Resolve a variable read to a local slot, a global slot or a name lookup.
+ */
+static void bind_use(ParseNode *identifier, Scope *scope) {
+    char *name = node_name(identifier);
+    int slot;
+    if ((slot = scope_find(scope, name)) >= 0) {
+        node_set_scope(identifier, scope);
+        identifier->slot = slot;
+    } else if (scope != globals && (slot = scope_find(globals, name)) >= 0) {
+        node_set_scope(identifier, globals);
+        identifier->slot = slot;
+    } else {
+        node_set_scope(identifier, NULL);
+        identifier->slot = -1;
+    }
+
+    if (node_scope(identifier) != scope) {
+        scope_declare(read_by_name, name);
+    }
+}
+
+/**
+ * @brief Resolve an assignment target. Assignment always binds in the
+ *        current frame, so a target is never resolved to a global slot.
+ */
+static void bind_target(ParseNode *identifier, Scope *scope) {
+    node_set_scope(identifier, scope);
+    identifier->slot = scope_find(scope, node_name(identifier));
+    if (identifier->slot < 0) {
+        node_set_scope(identifier, NULL);
+    }
+}
+
+static void add_function_scope(Scope *scope) {
+    if (function_count + 1 > function_capacity) {
+        function_capacity = function_capacity < 8 ? 8 : function_capacity * 2;
+        function_scopes = realloc(function_scopes, function_capacity * sizeof(Scope*));
+        if (!function_scopes) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    function_scopes[function_count++] = scope;
+}
+
+/**
+ * @brief Mark the returns of a call in a function's body, whose value becomes
+ *        the result of the function, so the call can reuse the function's
+ *        frame. A return leaves every statement list and loop up to the end
+ *        of the call, so each return found through them is one.
+ * @param node A statement of the function, not descending into definitions.
+ * @param scope The scope of the function.
+ */
+static void mark_tail_calls(ParseNode *node, Scope *scope) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case STATEMENT_LIST:
+            for (int i = 0; i < node->item_count; i++) {
+                mark_tail_calls(node_item(node, i), scope);
+            }
+            break;
+        case IF:
+        case TERN_IF:
+            mark_tail_calls(node_left(node_right(node)), scope);
+            mark_tail_calls(node_right(node_right(node)), scope);
+            break;
+        case WHILE:
+        case FOR:
+            mark_tail_calls(node_right(node), scope);
+            break;
+        case RETURN:
+            if (node_left(node) != NULL && node_left(node)->type == IDENTIFIER) {
+                node_set_scope(node, scope);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void resolve_function(ParseNode *node, Scope *scope) {
+    bind_target(node_left(node), scope);
+
+    Scope *body_scope = scope_create();
+    for (int i = 0; i < node_left(node)->item_count; i++) {
+        ParseNode *param = node_item(node_left(node), i);
+        mark_shadowed(node_name(param));
+        param->slot = scope_declare(body_scope, node_name(param));
+        node_set_scope(param, body_scope);
+    }
+
+    collect(node_right(node), body_scope);
+    resolve_node(node_right(node), body_scope);
+    mark_tail_calls(node_right(node), body_scope);
+    node_set_scope(node, body_scope);
+    add_function_scope(body_scope);
+}
+
+static void resolve_class(ParseNode *node, Scope *scope) {
+    bind_target(node_left(node), scope);
+
+    // Objects keep their fields by name, so the body is resolved dynamically
+    for (int i = 0; i < node_left(node)->item_count; i++) {
+        mark_shadowed(node_name(node_item(node_left(node), i)));
+    }
+    collect(node_right(node), NULL);
+    resolve_node(node_right(node), NULL);
+}
+
+static void resolve_items(ParseNode *node, Scope *scope) {
+    for (int i = 0; i < node->item_count; i++) {
+        resolve_node(node_item(node, i), scope);
+    }
+}
+
+static void resolve_node(ParseNode *node, Scope *scope) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case IDENTIFIER:
+            bind_use(node, scope);
+            resolve_items(node, scope);
+            break;
+        case ASSIGNMENT:
+            if (node_left(node) && node_left(node)->type == IDENTIFIER) {
+                bind_target(node_left(node), scope);
+            } else {
+                resolve_node(node_left(node), scope);
+            }
+            resolve_node(node_right(node), scope);
+            break;
+        case FUNCTION:
+            resolve_function(node, scope);
+            break;
+        case CLASS:
+            resolve_class(node, scope);
+            break;
+        case SET:
+            // The object is found by searching the call stack for self
+            mark_shadowed(node_name(node_left(node)));
+            scope_declare(read_by_name, intern_string("self"));
+            resolve_node(node_right(node), scope);
+            break;
+        case OP_DOT:
+            // The member name is looked up on the object, only its arguments are variables
+            resolve_node(node_left(node), scope);
+            if (node_right(node)) {
+                resolve_items(node_right(node), scope);
+            }
+            break;
+        case IMPORT:
+            has_import = true;
+            break;
+        default:
+            resolve_node(node_left(node), scope);
+            resolve_node(node_right(node), scope);
+            resolve_items(node, scope);
+            break;
+    }
+}
+
+/**
+ * @brief Assigns slots to the variables of a program and its functions
+ * @param program The PROGRAM node returned by parse()
+ * @return The global scope, also stored on the program node
+ */
+Scope *resolve_program(ParseNode *program) {
+    globals = scope_create();
+    read_by_name = scope_create();
+    has_import = false;
+    function_count = 0;
+
+    collect(program, globals);
+    resolve_node(program, globals);
+
+    // Imported code is only resolved once it runs, so it could read any name
+    for (int i = 0; i < function_count && !has_import; i++) {
+        Scope *function = function_scopes[i];
+        function->private = true;
+        for (int slot = 0; slot < function->count; slot++) {
+            if (scope_find(read_by_name, function->names[slot]) >= 0) {
+                function->private = false;
+                break;
+            }
+        }
+    }
+    free(function_scopes);
+    function_scopes = NULL;
+    function_count = function_capacity = 0;
+    scope_destroy(read_by_name);
+    read_by_name = NULL;
+
+    node_set_scope(program, globals);
+    return globals;
+}
+
+/**
+ * @brief Resolves an imported program. Its top level binds into whichever
+ *        frame runs the import, so only its functions get slots.
+ * @param program The PROGRAM node of the imported file
+ * @param main_globals The global scope of the main program
+ */
+void resolve_import(ParseNode *program, Scope *main_globals) {
+    Scope *enclosing = globals;
+    globals = main_globals;
+    read_by_name = scope_create();
+
+    collect(program, NULL);
+    resolve_node(program, NULL);
+
+    // Frames of imported functions are never reused, as names are only known per file
+    free(function_scopes);
+    function_scopes = NULL;
+    function_count = function_capacity = 0;
+    scope_destroy(read_by_name);
+    read_by_name = NULL;
+
+    globals = enclosing;
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "runtime.h"
+#include "features/hashmap.h"
+#include "utils/call_stack.h"
+
+// Bodies of the translated functions, indexed by the slot of their node
+static const NativeBody *native_bodies = NULL;
+
+// A call in tail position, waiting for rt_call() to run it in its frame
+static struct {
+    ParseNode *site;        // The identifier of the call, NULL when none is waiting
+    ParseNode *definition;
+    Value *args;            // The bound arguments, a GC root array
+    int argc;
+    int capacity;
+} tail_call = { NULL, NULL, NULL, 0, 0 };
+
+Scope *rt_scope(char **names, const bool *shadowed, int count) {
+    Scope *scope = scope_create();
+    for (int i = 0; i < count; i++) {
+        names[i] = intern_string(names[i]);
+        scope_declare(scope, names[i]);
+        scope->shadowed[i] = shadowed != NULL && shadowed[i];
+    }
+    return scope;
+}
+
+void rt_node(ParseNode *node, TokenType type, int line, const char *name, Scope *scope, int slot) {
+    node->type = type;
+    node->line = line;
+    if (name != NULL) {
+        node_set_name(node, intern_string(name));
+    }
+    if (scope != NULL) {
+        node_set_scope(node, scope);
+    }
+    node->slot = slot;
+}
+
+void rt_start(Scope *globals, const NativeBody *bodies) {
+    native_bodies = bodies;
+    init_call_stack(globals);
+    gc_add_roots(&tail_call.args, &tail_call.argc);
+}
+
+int rt_finish(Value result) {
+    // Mirrors evaluate_program() and the end of the interpreter
+    if (IS_NONE(result)) {
+        fprintf(stderr, "Evaluation failed\n");
+    } else {
+        cleanup();
+    }
+    gc_remove_roots(&tail_call.args);
+    free(tail_call.args);
+    gc_free_all();
+    intern_free_all();
+    node_store_free();
+    return 0;
+}
+
+Value rt_string(const char *chars) {
+    size_t length = strlen(chars);
+    if (length <= SHORT_STRING_MAX) {
+        return short_string_val(chars, length);
+    }
+
+    Obj *string = gc_malloc();
+    string->type = TYPE_STRING;
+    string->interned = true;
+    string->data.stringValue = intern_string(chars);
+    string->length = SYMBOL(string->data.stringValue)->length;
+
+    Value value = OBJ_VAL(string);
+    gc_reference(value);
+    return value;
+}
+
+Value rt_lookup(ParseNode *identifier) {
+    Value value;
+    if (!stack_lookup(callStack, node_scope(identifier), identifier->slot, node_name(identifier), &value)) {
+        error_and_exit(identifier, "Identifier not yet declared");
+    }
+    return value;
+}
+
+int rt_arity(Value callee, int argc) {
+    if (value_type(callee) == TYPE_NATIVE) return argc;
+    if (value_type(callee) != TYPE_FUNCTION) return 0;
+
+    int params = node_left(AS_NODE(callee))->item_count;
+    return argc < params ? argc : params;
+}
+
+Value rt_call(ParseNode *site, Value callee, Value *args, int argc) {
+    if (value_type(callee) == TYPE_NATIVE) {
+        return AS_NATIVE(callee)(site, args, argc);
+    }
+
+    ParseNode *definition = AS_NODE(callee);
+
+    StackFrame *frame = frame_create(node_name(site), node_scope(definition));
+    for (int i = 0; i < argc; i++) {
+        frame_set_slot(frame, node_item(node_left(definition), i)->slot, args[i]);
+    }
+
+    stack_push(callStack, frame);
+
+    // A call in tail position takes over the frame and runs in its place
+    Value result;
+    for (;;) {
+        result = native_bodies[definition->slot]();
+        if (tail_call.site == NULL) break;
+
+        definition = tail_call.definition;
+        frame_reset(frame, node_name(tail_call.site), node_scope(definition));
+        for (int i = 0; i < tail_call.argc; i++) {
+            frame_set_slot(frame, node_item(node_left(definition), i)->slot, tail_call.args[i]);
+        }
+        tail_call.site = NULL;
+        tail_call.argc = 0;
+    }
+
+    frame = stack_pop(callStack);
+    frame_destroy(frame, 1);
+    return result;
+}
+
+Value rt_tail_call(ParseNode *site, Value callee, Value *args, int argc) {
+    if (argc > tail_call.capacity) {
+        tail_call.capacity = argc < 8 ? 8 : argc;
+        tail_call.args = realloc(tail_call.args, tail_call.capacity * sizeof(Value));
+        if (!tail_call.args) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < argc; i++) {
+        tail_call.args[i] = args[i];
+    }
+    tail_call.site = site;
+    tail_call.definition = AS_NODE(callee);
+    tail_call.argc = argc;
+    return NONE_VAL;
+}
+
+Value rt_function(ParseNode *definition) {
+    Obj *function = gc_malloc();
+    function->type = TYPE_FUNCTION;
+    function->data.node = definition;
+
+    Value value = OBJ_VAL(function);
+    assign_variable(node_left(definition), value);
+    return value;
+}
+
+Value rt_list(int capacity) {
+    Obj *list = gc_malloc();
+    list->type = TYPE_LIST;
+    list->data.list = list_create(capacity);
+    return OBJ_VAL(list);
+}
+
+Value rt_map() {
+    HashMap *map = hashmap_create(0);
+    Obj *map_value = gc_malloc();
+    map_value->type = TYPE_MAP;
+    map_value->data.map = map;
+    return OBJ_VAL(map_value);
+}
+
+bool rt_map_set(ParseNode *pair, Value map, Value key, Value value) {
+    if (value_type(key) != TYPE_STRING) {
+        runtime_error(pair, "Map key must be a string");
+        return false;
+    }
+    hashmap_set(AS_MAP(map), AS_STRING(key), value);
+    return true;
+}
+
+void rt_return() {
+    stack_peek(callStack)->status = 1;
+}
+
+bool rt_returned() {
+    return stack_peek(callStack)->status == 1;
+}
+
+Value *rt_slots() {
+    return stack_peek(callStack)->slots;
+}
@@ -1,7 +1,15 @@
+#include <string.h>
+#include <sys/mman.h>
 #include "token.h"
 #include "features/list.h"
 #include "utils/hash_table.h"
+#include "features/hashmap.h"
 #include "garbage_collector.h"
+#include "bytecode.h"
+#include "resolver.h"
+#include "utils/arena.h"
+#include "features/object.h"
+#include "utils/intern.h"
 
 int is_operator(TokenType type) {
     return type == OP_ADD || type == OP_SUB || type == OP_MUL || type == OP_DIV || type == OP_MOD ||
@@ -17,20 +25,159 @@ int is_compound_assignment_operator(TokenType type) {
            type == OP_MOD_EQUALS;
 }
 
-ParseNode *parse_node_create(TokenType type){
-    ParseNode *node = malloc(sizeof(ParseNode));
-    if (!node) {
+// The most nodes, payloads and items the store reserves room for, 32M of each
+#define NODE_STORE_MAX (1u << 25)
+
+NodeStore node_store = { NULL, 0, NULL, 0, NULL, 0 };
+
+/**
+ * @brief Reserve the address space of an array without committing memory, so
+ *        it can grow in place.
+ */
+static void *reserve(size_t size) {
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(1);
     }
+    return memory;
+}
+
+static void node_store_init() {
+    node_store.nodes = reserve(NODE_STORE_MAX * sizeof(ParseNode));
+    node_store.payloads = reserve(NODE_STORE_MAX * sizeof(NodePayload));
+    node_store.items = reserve(NODE_STORE_MAX * sizeof(NodeIndex));
+    node_store.node_count = 1;
+    node_store.payload_count = 1;
+    node_store.item_count = 1;
+}
+
+static void check_room(uint32_t count, uint32_t more) {
+    if (more > NODE_STORE_MAX - count) {
+        fprintf(stderr, "Program too large, more than %u nodes\n", NODE_STORE_MAX);
+        exit(1);
+    }
+}
+
+/**
+ * @brief Take nodes from the end of the store, all zero.
+ * @param count The number of nodes, which sit next to each other.
+ * @return The first of the nodes.
+ */
+ParseNode *node_store_alloc(int count) {
+    if (node_store.nodes == NULL) {
+        node_store_init();
+    }
+    check_room(node_store.node_count, count);
+    ParseNode *nodes = &node_store.nodes[node_store.node_count];
+    node_store.node_count += count;
+    return nodes;
+}
+
+/**
+ * @brief Give a node a payload of its own, all NULL.
+ * @return The payload, which stays where it is.
+ */
+NodePayload *node_payload_create(ParseNode *node) {
+    check_room(node_store.payload_count, 1);
+    node->payload = node_store.payload_count++;
+    return NODE_PAYLOAD(node);
+}
+
+/**
+ * @brief Copy the children of a sequence node into the item pool.
+ * @param node The sequence node.
+ * @param items The children, in order.
+ * @param count The number of children.
+ */
+void node_set_items(ParseNode *node, ParseNode **items, int count) {
+    check_room(node_store.item_count, count);
+    node->items = count > 0 ? node_store.item_count : 0;
+    node->item_count = count;
+    for (int i = 0; i < count; i++) {
+        node_store.items[node_store.item_count++] = node_index(items[i]);
+    }
+}
+
+/**
+ * @brief Unmap the store, once no tree is used any more. Used at exit.
+ */
+void node_store_free() {
+    if (node_store.nodes == NULL) return;
+    munmap(node_store.nodes, NODE_STORE_MAX * sizeof(ParseNode));
+    munmap(node_store.payloads, NODE_STORE_MAX * sizeof(NodePayload));
+    munmap(node_store.items, NODE_STORE_MAX * sizeof(NodeIndex));
+    node_store = (NodeStore){ NULL, 0, NULL, 0, NULL, 0 };
+}
+
+/**
+ * @brief Release what a node owns outside the store: the chunk compiled for
+ *        it, the scope the resolver gave it, or the shapes or inline cache
+ *        created while the program ran.
+ */
+static void release_node(void *data) {
+    ParseNode *node = data;
+    switch (node->type) {
+        case OP_DOT:
+            free(node_cache(node));
+            break;
+        case CLASS:
+            chunk_destroy(node_code(node));
+            shape_destroy(node_shape(node));
+            break;
+        case PROGRAM:
+        case FUNCTION:
+            chunk_destroy(node_code(node));
+            scope_destroy(node_scope(node));
+            break;
+        default:
+            chunk_destroy(node_code(node));
+            break;
+    }
+}
+
+/**
+ * @brief Create a node at the end of the node store.
+ * @param arena The arena that owns the rest of the syntax tree, which releases
+ *        what the node comes to own when it is destroyed.
+ * @param type The type of the node.
+ * @return The node.
+ */
+ParseNode *parse_node_create(Arena *arena, TokenType type){
+    // The pages of the store start zeroed, so only the non-zero fields are set
+    ParseNode *node = node_store_alloc(1);
     node->type = type;
-    node->value.type = TYPE_NONE;
+    node->slot = -1;
 
-    node->left = NULL;
-    node->right = NULL;
+    // Only these nodes are given a chunk, a scope, a shape or a cache later on
+    if (type == PROGRAM || type == FUNCTION || type == CLASS || type == IMPORT || type == OP_DOT) {
+        arena_defer(arena, release_node, node);
+    }
     return node;
 }
 
+/**
+ * @brief Make the value of a string literal. Short literals are held in the
+ *        value, others in a string object that lives in the arena of the
+ *        file, so the collector never frees it.
+ * @param arena The arena of the file being parsed.
+ * @param text The interned characters.
+ * @return The string value.
+ */
+Value string_literal_create(Arena *arena, char *text) {
+    if (SYMBOL(text)->length <= SHORT_STRING_MAX) {
+        return short_string_val(text, SYMBOL(text)->length);
+    }
+
+    Obj *string = arena_alloc(arena, sizeof(Obj));
+    memset(string, 0, sizeof(Obj));
+    string->type = TYPE_STRING;
+    string->interned = true;
+    string->data.stringValue = text;
+    string->length = SYMBOL(text)->length;
+    return OBJ_VAL(string);
+}
+
 const char *token_type_to_string(TokenType type) {
     switch (type) {
         case PROGRAM: return "PRGRM";
@@ -42,95 +189,106 @@ const char *token_type_to_string(TokenType type) {
     }
 }
 
-Value *value_create(ValueType type) {
-    Value *value = malloc(sizeof(Value));
-    value->type = type;
-}
+Value value_copy(Value old) {
+    if (!IS_OBJ(old)) {
+        return old;
+    }
 
-Value *value_copy(Value *old) {
-    Value *copy = gc_malloc();
-    copy->type = old->type;
+    gc_push_root(old);
+    Obj *original = AS_OBJ(old);
+    Obj *copy = gc_malloc();
+    copy->type = original->type;
+    gc_pop_roots(1);
 
-    switch (old->type) {
-        case TYPE_INT:
-            copy->data.intValue = old->data.intValue;
-            break;
-        case TYPE_FLOAT:
-            copy->data.floatValue = old->data.floatValue;
-            break;
+    switch (original->type) {
         case TYPE_STRING:
-            if (old->data.stringValue)
-                copy->data.stringValue = strdup(old->data.stringValue);
-            else
-                copy->data.stringValue = NULL;
+            // Strings are immutable, so a copy can share interned characters
+            if (original->interned) {
+                copy->data.stringValue = original->data.stringValue;
+                copy->interned = true;
+            } else {
+                copy->data.stringValue = strdup(AS_STRING(old));
+            }
+            copy->length = original->length;
             break;
         case TYPE_LIST:
-            List *list = list_create(old->data.list->array_length);
-            list_copy(old->data.list, list,0);
+            List *list = list_create(original->data.list->array_length);
+            list_copy(original->data.list, list,0);
             copy->data.list = list;
             break;
         default:
-            fprintf(stderr, "Unknown ValueType in value_copy\n");
-            printf("Type: %d\n", old->type);
-            gc_dereference(copy);
-            return NULL;
+            // The copy is already tracked by the collector, which frees it
+            fprintf(stderr, "Unknown ValueType in value_copy\nType: %d\n", original->type);
+            return old;
     }
 
-    return copy;
+    return OBJ_VAL(copy);
 }
 
-void value_destroy(Value value) {
-    switch (value.type) {
+/**
+ * @brief Free what a heap object owns, but not the object itself. Called by
+ *        the collector, so the values it refers to are handled separately.
+ * @param object The object being freed.
+ */
+void value_destroy(Obj *object) {
+    switch (object->type) {
         case TYPE_OBJECT:
-            // Derefence self to stop infinite loop
-            hashtable_set(value.data.object_fields, "self", value_create(TYPE_NONE));
-
-            hashtable_destroy(value.data.object_fields);
-            value.data.object_fields = NULL;
-            value.type = TYPE_NONE;
+            free(object->data.object.fields);
+            object->data.object.fields = NULL;
             break;
         case TYPE_LIST:
-            list_destroy(value.data.list);
-            value.data.list = NULL;
-            value.type = TYPE_NONE;
-            break;
-        // TODO: this is needed but was breaking things
-        // case TYPE_STRING:
-        //     free(value.data.stringValue);
-        //     value.type = TYPE_NONE;
-        //     break;
+            list_destroy(object->data.list);
+            object->data.list = NULL;
+            break;
+        case TYPE_MAP:
+            hashmap_destroy(object->data.map);
+            object->data.map = NULL;
+            break;
+        case TYPE_STRING:
+            if (!object->interned && !object->rope) free(object->data.stringValue);
+            object->data.stringValue = NULL;
+            break;
+        default:
+            break;
     }
+    object->type = TYPE_NONE;
 }
 
-void print_value(Value *value) {
-    if (value == NULL) {
-        printf("NULL");
-        return;
-    }
-    if (value->type == TYPE_INT || value->type == TYPE_BOOL) {
-        printf("%d", value->data.intValue);
-    }
-    else if (value->type == TYPE_FLOAT) {
-        printf("%f", value->data.floatValue);
-    }
-    else if (value->type == TYPE_STRING) {
-        printf("%s", value->data.stringValue);
-    }
-    else if (value->type == TYPE_OBJECT) {
-        printf("OBJECT");
-    }
-    else if (value->type == TYPE_LIST) {
-        printf("[");
-        for (int i = 0; i <= value->data.list->tail; i++) {
-            print_value(value->data.list->items[i]);
-            if (i < value->data.list->tail) {
-                printf(",");
+void print_value(Value value) {
+    switch (value_type(value)) {
+        case TYPE_NONE:
+            printf("NULL");
+            break;
+        case TYPE_INT:
+            printf("%d", AS_INT(value));
+            break;
+        case TYPE_BOOL:
+            printf("%d", AS_BOOL(value));
+            break;
+        case TYPE_FLOAT:
+            printf("%f", AS_FLOAT(value));
+            break;
+        case TYPE_STRING:
+            printf("%s", AS_STRING(value));
+            break;
+        case TYPE_OBJECT:
+            printf("OBJECT");
+            break;
+        case TYPE_LIST: {
+            List *list = AS_LIST(value);
+            printf("[");
+            for (int i = 0; i <= list->tail; i++) {
+                print_value(list->items[i]);
+                if (i < list->tail) {
+                    printf(",");
+                }
             }
+            printf("]");
+            break;
         }
-        printf("]");
-    } else {
-        printf("VALUE(?)");
-        printf("Type: %d", value->type);
+        default:
+            printf("VALUE(?)");
+            printf("Type: %d", value_type(value));
     }
 }
 
@@ -153,12 +311,19 @@ void print_binary_operator(ParseNode *node) {
         case ASSIGNMENT: printf("="); break;
     }
     printf(" ");
-    print_ast(node->left);
+    print_ast(node_left(node));
     printf(",");
-    print_ast(node->right);
+    print_ast(node_right(node));
     printf(") ");
 }
 
+static void print_items(ParseNode *node, const char *separator) {
+    for (int i = 0; i < node->item_count; i++) {
+        if (i > 0) printf("%s", separator);
+        print_ast(node_item(node, i));
+    }
+}
+
 void print_ast(ParseNode *node) {
     if (node == NULL) return;
 
@@ -168,94 +333,86 @@ void print_ast(ParseNode *node) {
         case OP_NEQ: case ASSIGNMENT: case OP_AND: case OP_OR:
             print_binary_operator(node);
             break;
-        case LITERAL: case IDENTIFIER:
-            if (node->value.type == TYPE_INT) {
-                printf("%d", node->value.data.intValue);
+        case LITERAL:
+            if (IS_INT(node_literal(node))) {
+                printf("%d", AS_INT(node_literal(node)));
             } 
-            else if (node->value.type == TYPE_FLOAT) {
-                printf("%.2f", node->value.data.floatValue);
+            else if (IS_FLOAT(node_literal(node))) {
+                printf("%.2f", AS_FLOAT(node_literal(node)));
             } 
-            else if (node->value.type == TYPE_BOOL) {
-                printf("%d", node->value.data.intValue);
+            else if (IS_BOOL(node_literal(node))) {
+                printf("%d", AS_BOOL(node_literal(node)));
             } 
-            else if (node->value.data.stringValue != NULL){
-                printf("%s", node->value.data.stringValue);
+            else if (value_type(node_literal(node)) == TYPE_STRING) {
+                printf("%s", AS_STRING(node_literal(node)));
             }
+            break;
+        case IDENTIFIER:
+            printf("%s", node_name(node));
 
-            if (node->right!=NULL){
+            for (int i = 0; i < node->item_count; i++) {
                 printf(",");
-                print_ast(node->right);
+                print_ast(node_item(node, i));
             }
 
             break;
-        case PROGRAM: case STATEMENT_LIST: case CLASS:
+        case PROGRAM: case STATEMENT_LIST:
             printf("%s: ", token_type_to_string(node->type));
-            print_ast(node->left);
-            print_ast(node->right);
+            print_items(node, " ");
+            break;
+        case CLASS:
+            printf("%s: ", token_type_to_string(node->type));
+            print_ast(node_left(node));
+            print_ast(node_right(node));
             break;
         case FUNCTION: case WHILE:
             printf("%s: ", token_type_to_string(node->type));
-            print_ast(node->left);
+            print_ast(node_left(node));
             printf(" BODY: ");
-            print_ast(node->right);
+            print_ast(node_right(node));
             break;
         case LIST:
             printf("[");
-            print_ast(node->right);
+            print_items(node, ",");
             printf("]");
             break;
         case IF:
             printf("IF ");
-            print_ast(node->left);
+            print_ast(node_left(node));
             printf("THEN ");
-            print_ast(node->right->left);
+            print_ast(node_left(node_right(node)));
             printf("ELSE");
-            print_ast(node->right->right);
+            print_ast(node_right(node_right(node)));
             break;
         case FOR:
             printf("FOR: ");
-            print_ast(node->left->left);
-            print_ast(node->left->right->left);
-            print_ast(node->left->right->right);
+            print_ast(node_left(node_left(node)));
+            print_ast(node_left(node_right(node_left(node))));
+            print_ast(node_right(node_right(node_left(node))));
             printf(" DO: ");
-            print_ast(node->right);
+            print_ast(node_right(node));
             break;
         case OP_INDEX:
             printf("INDEX: ");
-            print_ast(node->left);
-            print_ast(node->right);
+            print_ast(node_left(node));
+            print_ast(node_right(node));
             break;
         case OUT:
             printf("OUT: ");
-            print_ast(node->left);
+            print_ast(node_left(node));
             break;
         case MAP:
             printf("MAP: ");
-            print_ast(node->right);
+            print_items(node, ",");
             break;
         case COLON:
             printf("PAIR: ");
-            print_ast(node->left);
+            print_ast(node_left(node));
             printf(":");
-            print_ast(node->right);
+            print_ast(node_right(node));
             break;
         default:
             printf("?");
             break;
     }
-}
-
-void free_ast(ParseNode *node) {
-    if (!node) return;
-    free_ast(node->left);
-    free_ast(node->right);
-
-    Value value = node->value;
-    switch (value.type) {
-        case TYPE_METADATA:
-            free(value.data.stringValue);
-            break;
-    }
-
-    free(node);
 }
\ No newline at end of file
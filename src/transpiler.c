@@ -0,0 +1,751 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include "token.h"
+#include "transpiler.h"
+#include "resolver.h"
+
+/**
+ * Every node becomes C statements leaving its value in a temporary, declared
+ * at the top of the function it is in. Nodes the runtime needs, for their
+ * variable, operator or line, are rebuilt in a static array when the program
+ * starts.
+ */
+
+typedef struct Buffer {
+    char *chars;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static Buffer init_code;      // Statements of init_nodes()
+static Buffer function_code;  // Definitions of the translated functions
+static Buffer *code;          // Body of the function being translated
+static int indent;
+static int temp_count;        // Temporaries of the function being translated
+static Scope *current_scope;  // Scope of the frame the function runs in
+static bool uses_slots;       // Whether the function reads its slots directly
+
+static int node_count;
+static int string_count;
+
+static ParseNode **functions; // Definitions to translate, by index
+static int function_count;
+static int function_capacity;
+
+static Scope **scopes;
+static int scope_count;
+static int scope_capacity;
+
+static const char *source_name;
+static bool failed;
+
+static void append_va(Buffer *buffer, const char *format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+
+    if (buffer->length + length + 1 > buffer->capacity) {
+        buffer->capacity = (buffer->length + length + 1) * 2;
+        buffer->chars = realloc(buffer->chars, buffer->capacity);
+        if (!buffer->chars) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    vsnprintf(buffer->chars + buffer->length, length + 1, format, args);
+    buffer->length += length;
+}
+
+static void append(Buffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    append_va(buffer, format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Append an indented line to the function being translated.
+ */
+static void line(const char *format, ...) {
+    append(code, "%*s", indent * 4, "");
+    va_list args;
+    va_start(args, format);
+    append_va(code, format, args);
+    va_end(args);
+    append(code, "\n");
+}
+
+/**
+ * @brief Append a string as a C string literal.
+ */
+static void append_string(Buffer *buffer, const char *string) {
+    append(buffer, "\"");
+    for (const unsigned char *c = (const unsigned char *)string; *c != '\0'; c++) {
+        switch (*c) {
+            case '"': append(buffer, "\\\""); break;
+            case '\\': append(buffer, "\\\\"); break;
+            case '\n': append(buffer, "\\n"); break;
+            case '\t': append(buffer, "\\t"); break;
+            default:
+                if (*c < ' ' || *c >= 0x7f) {
+                    append(buffer, "\\%03o", *c);
+                } else {
+                    append(buffer, "%c", *c);
+                }
+        }
+    }
+    append(buffer, "\"");
+}
+
+static void buffer_free(Buffer *buffer) {
+    free(buffer->chars);
+    buffer->chars = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+static void unsupported(ParseNode *node, const char *what) {
+    if (!failed) {
+        fprintf(stderr, "%s:%d: %s cannot be translated to C\n", source_name, node->line, what);
+    }
+    failed = true;
+}
+
+static const char *type_name(TokenType type) {
+    switch (type) {
+        case IDENTIFIER: return "IDENTIFIER";
+        case FUNCTION: return "FUNCTION";
+        case ASSIGNMENT: return "ASSIGNMENT";
+        case OP_ADD: return "OP_ADD";
+        case OP_SUB: return "OP_SUB";
+        case OP_MUL: return "OP_MUL";
+        case OP_DIV: return "OP_DIV";
+        case OP_MOD: return "OP_MOD";
+        case OP_GT: return "OP_GT";
+        case OP_GTE: return "OP_GTE";
+        case OP_LT: return "OP_LT";
+        case OP_LTE: return "OP_LTE";
+        case OP_EQ: return "OP_EQ";
+        case OP_NEQ: return "OP_NEQ";
+        case OP_INDEX: return "OP_INDEX";
+        case COLON: return "COLON";
+        case IN: return "IN";
+        case OUT: return "OUT";
+        default: return "NONE";
+    }
+}
+
+/**
+ * @brief The index of a scope in the scopes array, adding it on first use.
+ */
+static int scope_ref(Scope *scope) {
+    for (int i = 0; i < scope_count; i++) {
+        if (scopes[i] == scope) return i;
+    }
+    if (scope_count + 1 > scope_capacity) {
+        scope_capacity = scope_capacity < 8 ? 8 : scope_capacity * 2;
+        scopes = realloc(scopes, scope_capacity * sizeof(Scope*));
+        if (!scopes) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    scopes[scope_count] = scope;
+    return scope_count++;
+}
+
+/**
+ * @brief Rebuild a node at startup for the runtime to use.
+ * @return Its index in the nodes array.
+ */
+static int node_ref(ParseNode *node) {
+    int id = node_count++;
+    append(&init_code, "    rt_node(&nodes[%d], %s, %d, ", id, type_name(node->type), node->line);
+    if (node->type == IDENTIFIER) {
+        append_string(&init_code, node_name(node));
+    } else {
+        append(&init_code, "NULL");
+    }
+    if (node->type == IDENTIFIER && node_scope(node) != NULL) {
+        append(&init_code, ", scopes[%d], %d);\n", scope_ref(node_scope(node)), node->slot);
+    } else {
+        append(&init_code, ", NULL, -1);\n");
+    }
+    return id;
+}
+
+static int new_temp() {
+    return temp_count++;
+}
+
+static int compile(ParseNode *node);
+
+/**
+ * @brief A statement list stops after a return, the way
+ *        evaluate_statement_list() does, and so do the lists and loops
+ *        around it up to the end of the call.
+ */
+static int compile_statement_list(ParseNode *node) {
+    int result = new_temp();
+    if (node->item_count == 0) {
+        line("t%d = NONE_VAL;", result);
+        return result;
+    }
+
+    line("do {");
+    indent++;
+    for (int i = 0; i < node->item_count - 1; i++) {
+        int value = compile(node_item(node, i));
+        line("if (rt_returned()) { t%d = t%d; break; }", result, value);
+    }
+    int last = compile(node_item(node, node->item_count - 1));
+    line("t%d = t%d;", result, last);
+    indent--;
+    line("} while (0);");
+    return result;
+}
+
+static int compile_literal(ParseNode *node) {
+    int result = new_temp();
+    Value value = node_literal(node);
+
+    if (IS_FLOAT(value)) {
+        double number = AS_FLOAT(value);
+        if (isfinite(number)) {
+            line("t%d = FLOAT_VAL(%a);", result, number);
+        } else {
+            line("t%d = (Value)0x%016llxULL;", result, (unsigned long long)value);
+        }
+    } else if (IS_INT(value)) {
+        line("t%d = INT_VAL(%d);", result, AS_INT(value));
+    } else if (IS_BOOL(value)) {
+        line("t%d = %s;", result, AS_BOOL(value) ? "TRUE_VAL" : "FALSE_VAL");
+    } else if (IS_NONE(value)) {
+        line("t%d = NONE_VAL;", result);
+    } else if (value_type(value) == TYPE_STRING) {
+        int index = string_count++;
+        append(&init_code, "    strings[%d] = rt_string(", index);
+        append_string(&init_code, AS_STRING(value));
+        append(&init_code, ");\n");
+        line("t%d = strings[%d];", result, index);
+    } else {
+        unsupported(node, "This literal");
+    }
+    return result;
+}
+
+/**
+ * @brief Read a variable and call it if it holds a function, the way
+ *        evaluate_identifier() does. Only the arguments the function binds
+ *        are evaluated.
+ * @param tail Whether the call is returned in tail position, so a translated
+ *        function is run in the caller's frame by rt_tail_call().
+ */
+static int compile_call(ParseNode *node, bool tail) {
+    int result = new_temp();
+    int id = node_ref(node);
+
+    if (node->slot >= 0 && node_scope(node) == current_scope) {
+        uses_slots = true;
+        line("t%d = slots[%d];", result, node->slot);
+        line("if (IS_UNDEFINED(t%d)) t%d = rt_lookup(&nodes[%d]);", result, result, id);
+    } else {
+        line("t%d = rt_lookup(&nodes[%d]);", result, id);
+    }
+
+    line("if (value_type(t%d) == TYPE_FUNCTION || value_type(t%d) == TYPE_NATIVE) {", result, result);
+    indent++;
+    if (tail) {
+        line("ValueType type%d = value_type(t%d);", result, result);
+    }
+    if (node->item_count == 0) {
+        if (tail) {
+            line("if (type%d == TYPE_FUNCTION) t%d = rt_tail_call(&nodes[%d], t%d, NULL, 0);", result, result, id, result);
+            line("else t%d = rt_call(&nodes[%d], t%d, NULL, 0);", result, id, result);
+        } else {
+            line("t%d = rt_call(&nodes[%d], t%d, NULL, 0);", result, id, result);
+        }
+    } else {
+        line("int bound%d = rt_arity(t%d, %d);", result, result, node->item_count);
+        line("Value args%d[%d];", result, node->item_count);
+        line("gc_push_root(t%d);", result);
+        for (int i = 0; i < node->item_count; i++) {
+            line("if (bound%d > %d) {", result, i);
+            indent++;
+            int arg = compile(node_item(node, i));
+            line("args%d[%d] = t%d;", result, i, arg);
+            line("gc_push_root(t%d);", arg);
+            indent--;
+            line("}");
+        }
+        if (tail) {
+            line("if (type%d == TYPE_FUNCTION) t%d = rt_tail_call(&nodes[%d], t%d, args%d, bound%d);",
+                result, result, id, result, result, result);
+            line("else t%d = rt_call(&nodes[%d], t%d, args%d, bound%d);", result, id, result, result, result);
+        } else {
+            line("t%d = rt_call(&nodes[%d], t%d, args%d, bound%d);", result, id, result, result, result);
+        }
+        line("gc_pop_roots(bound%d + 1);", result);
+    }
+    indent--;
+    line("}");
+    return result;
+}
+
+static int compile_identifier(ParseNode *node) {
+    return compile_call(node, false);
+}
+
+static int compile_assignment(ParseNode *node) {
+    ParseNode *target = node_left(node);
+
+    if (target != NULL && target->type == IDENTIFIER) {
+        int value = compile(node_right(node));
+        if (target->slot >= 0 && node_scope(target) == current_scope) {
+            uses_slots = true;
+            line("slots[%d] = t%d;", target->slot, value);
+        } else {
+            line("assign_variable(&nodes[%d], t%d);", node_ref(target), value);
+        }
+        return value;
+    }
+
+    int result = new_temp();
+    if (target != NULL && target->type == OP_INDEX) {
+        int container = compile(node_left(target));
+        line("gc_push_root(t%d);", container);
+        int index = compile(node_right(target));
+        line("gc_push_root(t%d);", index);
+        int value = compile(node_right(node));
+        line("gc_pop_roots(2);");
+        line("t%d = apply_index_assignment(&nodes[%d], t%d, t%d, t%d);", result, node_ref(node), container, index, value);
+    } else {
+        line("runtime_error(&nodes[%d], \"Invalid assignment target\");", node_ref(node));
+        line("t%d = NONE_VAL;", result);
+    }
+    return result;
+}
+
+/**
+ * @brief Arithmetic and comparisons, computed inline on two ints and by the
+ *        evaluator's operators otherwise.
+ */
+static int compile_binary(ParseNode *node) {
+    const char *op;
+    const char *box = "BOOL_VAL";
+    const char *apply = "apply_op_binary";
+    switch (node->type) {
+        case OP_ADD: op = "+"; box = "INT_VAL"; apply = "apply_op_add"; break;
+        case OP_SUB: op = "-"; box = "INT_VAL"; break;
+        case OP_MUL: op = "*"; box = "INT_VAL"; break;
+        case OP_DIV: op = "/"; box = "INT_VAL"; break;
+        case OP_MOD: op = "%"; box = "INT_VAL"; break;
+        case OP_GT: op = ">"; break;
+        case OP_GTE: op = ">="; break;
+        case OP_LT: op = "<"; break;
+        case OP_LTE: op = "<="; break;
+        case OP_EQ: op = "=="; apply = "apply_op_eq"; break;
+        default: op = "!="; apply = "apply_op_eq"; break;
+    }
+
+    int left = compile(node_left(node));
+    line("gc_push_root(t%d);", left);
+    int right = compile(node_right(node));
+    line("gc_pop_roots(1);");
+
+    int result = new_temp();
+    line("t%d = IS_INT(t%d) && IS_INT(t%d) ? %s(AS_INT(t%d) %s AS_INT(t%d)) : %s(&nodes[%d], t%d, t%d);",
+        result, left, right, box, left, op, right, apply, node_ref(node), left, right);
+    return result;
+}
+
+static int compile_logical(ParseNode *node) {
+    int left = compile(node_left(node));
+    int result = new_temp();
+    line("t%d = BOOL_VAL(is_truthy(t%d));", result, left);
+
+    // The right operand only runs when the left one does not decide
+    line("if (t%d == %s) {", result, node->type == OP_AND ? "TRUE_VAL" : "FALSE_VAL");
+    indent++;
+    int right = compile(node_right(node));
+    line("t%d = BOOL_VAL(is_truthy(t%d));", result, right);
+    indent--;
+    line("}");
+    return result;
+}
+
+static int compile_index(ParseNode *node) {
+    int container = compile(node_left(node));
+    line("gc_push_root(t%d);", container);
+    int index = compile(node_right(node));
+    line("gc_pop_roots(1);");
+
+    int result = new_temp();
+    line("t%d = apply_op_index(&nodes[%d], t%d, t%d);", result, node_ref(node), container, index);
+    return result;
+}
+
+static int compile_list(ParseNode *node) {
+    int result = new_temp();
+    line("t%d = rt_list(%d);", result, node->item_count);
+    line("gc_push_root(t%d);", result);
+    for (int i = 0; i < node->item_count; i++) {
+        int item = compile(node_item(node, i));
+        line("list_add(AS_LIST(t%d), t%d);", result, item);
+    }
+    line("gc_pop_roots(1);");
+    return result;
+}
+
+static int compile_map(ParseNode *node) {
+    int result = new_temp();
+    line("t%d = rt_map();", result);
+    line("gc_push_root(t%d);", result);
+    line("do {");
+    indent++;
+    for (int i = 0; i < node->item_count; i++) {
+        ParseNode *pair = node_item(node, i);
+        int key = compile(node_left(pair));
+        line("gc_push_root(t%d);", key);
+        int value = compile(node_right(pair));
+        line("gc_pop_roots(1);");
+        line("if (!rt_map_set(&nodes[%d], t%d, t%d, t%d)) { t%d = NONE_VAL; break; }",
+            node_ref(pair), result, key, value, result);
+    }
+    indent--;
+    line("} while (0);");
+    line("gc_pop_roots(1);");
+    return result;
+}
+
+static int compile_if(ParseNode *node) {
+    if (node_right(node) == NULL) {
+        unsupported(node, "This if");
+        return new_temp();
+    }
+
+    int condition = compile(node_left(node));
+    int result = new_temp();
+    line("if (is_truthy(t%d)) {", condition);
+    indent++;
+    int then = compile(node_left(node_right(node)));
+    line("t%d = t%d;", result, then);
+    indent--;
+    line("} else {");
+    indent++;
+    if (node_right(node_right(node)) != NULL) {
+        int otherwise = compile(node_right(node_right(node)));
+        line("t%d = t%d;", result, otherwise);
+    } else {
+        line("t%d = NONE_VAL;", result);
+    }
+    indent--;
+    line("}");
+    return result;
+}
+
+/**
+ * @brief While and for loops, keeping the latest value of the body alive as
+ *        it becomes the value of the loop.
+ */
+static int compile_loop(ParseNode *node) {
+    ParseNode *condition = node_left(node);
+    ParseNode *change = NULL;
+    if (node->type == FOR) {
+        if (node_left(node) == NULL || node_right(node_left(node)) == NULL) {
+            unsupported(node, "This for loop");
+            return new_temp();
+        }
+        compile(node_left(node_left(node)));
+        condition = node_left(node_right(node_left(node)));
+        change = node_right(node_right(node_left(node)));
+    }
+
+    int result = new_temp();
+    line("t%d = NONE_VAL;", result);
+    line("gc_push_root(t%d);", result);
+    line("for (;;) {");
+    indent++;
+    int test = compile(condition);
+    line("if (!is_truthy(t%d)) break;", test);
+    int body = compile(node_right(node));
+    line("t%d = t%d;", result, body);
+    line("if (rt_returned()) break;");
+    line("gc_pop_roots(1);");
+    line("gc_push_root(t%d);", result);
+    if (change != NULL) {
+        compile(change);
+    }
+    indent--;
+    line("}");
+    line("gc_pop_roots(1);");
+    return result;
+}
+
+static int compile_function(ParseNode *node) {
+    if (function_count + 1 > function_capacity) {
+        function_capacity = function_capacity < 8 ? 8 : function_capacity * 2;
+        functions = realloc(functions, function_capacity * sizeof(ParseNode*));
+        if (!functions) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    int index = function_count++;
+    functions[index] = node;
+
+    // The definition keeps its body's scope and, as its slot, its index
+    // in the table of native bodies
+    ParseNode *name = node_left(node);
+    int name_id = node_ref(name);
+    int id = node_count++;
+    append(&init_code, "    rt_node(&nodes[%d], FUNCTION, %d, NULL, scopes[%d], %d);\n",
+        id, node->line, scope_ref(node_scope(node)), index);
+    append(&init_code, "    node_set_left(&nodes[%d], &nodes[%d]);\n", id, name_id);
+
+    if (name->item_count > 0) {
+        int first_param = node_count;
+        for (int i = 0; i < name->item_count; i++) {
+            node_ref(node_item(name, i));
+        }
+        append(&init_code, "    ParseNode *params%d[] = {", id);
+        for (int i = 0; i < name->item_count; i++) {
+            append(&init_code, "%s&nodes[%d]", i > 0 ? ", " : " ", first_param + i);
+        }
+        append(&init_code, " };\n");
+        append(&init_code, "    node_set_items(&nodes[%d], params%d, %d);\n", name_id, id, name->item_count);
+    }
+
+    int result = new_temp();
+    line("t%d = rt_function(&nodes[%d]);", result, id);
+    return result;
+}
+
+static int compile_unary(ParseNode *node, const char *apply) {
+    int operand = compile(node_left(node));
+    int result = new_temp();
+    line("t%d = %s(t%d);", result, apply, operand);
+    return result;
+}
+
+static int compile(ParseNode *node) {
+    if (node == NULL) {
+        int result = new_temp();
+        line("t%d = NONE_VAL;", result);
+        return result;
+    }
+
+    switch (node->type) {
+        case PROGRAM:
+        case STATEMENT_LIST:
+            return compile_statement_list(node);
+        case LITERAL: return compile_literal(node);
+        case IDENTIFIER: return compile_identifier(node);
+        case ASSIGNMENT: return compile_assignment(node);
+        case FUNCTION: return compile_function(node);
+        case LIST: return compile_list(node);
+        case MAP: return compile_map(node);
+        case WHILE:
+        case FOR:
+            return compile_loop(node);
+        case IF:
+        case TERN_IF:
+            return compile_if(node);
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_GT: case OP_GTE: case OP_LT: case OP_LTE:
+        case OP_EQ: case OP_NEQ:
+            return compile_binary(node);
+        case OP_AND:
+        case OP_OR:
+            return compile_logical(node);
+        case OP_NOT: return compile_unary(node, "apply_op_not");
+        case OP_INDEX: return compile_index(node);
+        case OUT: {
+            int value = compile(node_left(node));
+            int result = new_temp();
+            line("t%d = apply_out(&nodes[%d], t%d);", result, node_ref(node), value);
+            return result;
+        }
+        case IN: {
+            int result = new_temp();
+            line("t%d = evaluate_in(&nodes[%d]);", result, node_ref(node));
+            return result;
+        }
+        case RETURN:
+            // Like evaluate_return(), the frame is marked before the value runs,
+            // and a call the resolver marked reuses the frame of a private function
+            line("rt_return();");
+            if (node_scope(node) != NULL && node_scope(node)->private && node_scope(node) == current_scope) {
+                return compile_call(node_left(node), true);
+            }
+            return compile(node_left(node));
+        case CLASS:
+            unsupported(node, "A class");
+            return new_temp();
+        case OP_DOT:
+        case SET:
+            unsupported(node, "An object");
+            return new_temp();
+        case IMPORT:
+            unsupported(node, "An import");
+            return new_temp();
+        default:
+            unsupported(node, "This statement");
+            return new_temp();
+    }
+}
+
+/**
+ * @brief Declare the temporaries of a function once its body is known.
+ */
+static void append_temps(Buffer *buffer, int count) {
+    for (int i = 0; i < count; i++) {
+        append(buffer, i % 10 == 0 ? "    Value t%d" : ", t%d", i);
+        if (i % 10 == 9 || i == count - 1) {
+            append(buffer, ";\n");
+        }
+    }
+}
+
+/**
+ * @brief Translate a body into a buffer of its own, with a fresh set of
+ *        temporaries.
+ * @return The temporary holding the value of the body.
+ */
+static int compile_body(ParseNode *body, Scope *scope, Buffer *buffer) {
+    code = buffer;
+    indent = 1;
+    temp_count = 0;
+    uses_slots = false;
+    current_scope = scope;
+    return compile(body);
+}
+
+static void compile_functions() {
+    // Translating a body can add the functions defined in it
+    for (int i = 0; i < function_count; i++) {
+        ParseNode *definition = functions[i];
+        Buffer body = {0};
+        int result = compile_body(node_right(definition), node_scope(definition), &body);
+
+        append(&function_code, "// def %s on line %d\n", node_name(node_left(definition)), definition->line);
+        append(&function_code, "static Value function%d(void) {\n", i);
+        append_temps(&function_code, temp_count);
+        if (uses_slots) {
+            append(&function_code, "    Value *slots = rt_slots();\n");
+        }
+        append(&function_code, "%s", body.chars);
+        append(&function_code, "    return t%d;\n}\n\n", result);
+        buffer_free(&body);
+    }
+}
+
+static void write_scopes(FILE *out) {
+    fprintf(out, "static void init_scopes(void) {\n");
+    for (int i = 0; i < scope_count; i++) {
+        Scope *scope = scopes[i];
+        if (scope->count == 0) {
+            fprintf(out, "    scopes[%d] = rt_scope(NULL, NULL, 0);\n", i);
+            continue;
+        }
+
+        Buffer names = {0};
+        for (int slot = 0; slot < scope->count; slot++) {
+            append(&names, slot > 0 ? ", " : " ");
+            append_string(&names, scope->names[slot]);
+        }
+        fprintf(out, "    static char *names%d[] = {%s };\n", i, names.chars);
+        buffer_free(&names);
+
+        fprintf(out, "    static const bool shadowed%d[] = {", i);
+        for (int slot = 0; slot < scope->count; slot++) {
+            fprintf(out, "%s%s", slot > 0 ? ", " : " ", scope->shadowed[slot] ? "true" : "false");
+        }
+        fprintf(out, " };\n");
+        fprintf(out, "    scopes[%d] = rt_scope(names%d, shadowed%d, %d);\n", i, i, i, scope->count);
+    }
+    fprintf(out, "}\n\n");
+}
+
+static void reset() {
+    buffer_free(&init_code);
+    buffer_free(&function_code);
+    free(functions);
+    functions = NULL;
+    function_count = 0;
+    function_capacity = 0;
+    free(scopes);
+    scopes = NULL;
+    scope_count = 0;
+    scope_capacity = 0;
+    node_count = 0;
+    string_count = 0;
+    failed = false;
+}
+
+int emit_c(ParseNode *program, const char *source, FILE *out) {
+    source_name = source;
+    reset();
+
+    // The globals come first, the main frame is created from scopes[0]
+    scope_ref(node_scope(program));
+
+    Buffer main_body = {0};
+    int result = compile_body(program, node_scope(program), &main_body);
+    int main_temps = temp_count;
+    bool main_uses_slots = uses_slots;
+    compile_functions();
+
+    if (failed) {
+        buffer_free(&main_body);
+        reset();
+        return 1;
+    }
+
+    fprintf(out, "// Translated from %s by quokka --emit-c\n", source);
+    fprintf(out, "#include \"runtime.h\"\n\n");
+    fprintf(out, "static ParseNode *nodes;\n");
+    fprintf(out, "static Scope *scopes[%d];\n", scope_count);
+    if (string_count > 0) {
+        fprintf(out, "static Value strings[%d];\n", string_count);
+    }
+    fprintf(out, "\n");
+
+    for (int i = 0; i < function_count; i++) {
+        fprintf(out, "static Value function%d(void);\n", i);
+    }
+    if (function_count > 0) {
+        fprintf(out, "\nstatic const NativeBody bodies[] = {");
+        for (int i = 0; i < function_count; i++) {
+            fprintf(out, "%sfunction%d", i > 0 ? ", " : " ", i);
+        }
+        fprintf(out, " };\n\n");
+    }
+
+    write_scopes(out);
+    fprintf(out, "static void init_nodes(void) {\n    nodes = node_store_alloc(%d);\n%s}\n\n",
+        node_count, init_code.chars ? init_code.chars : "");
+    fprintf(out, "%s", function_code.chars ? function_code.chars : "");
+
+    fprintf(out, "int main(void) {\n");
+    Buffer declarations = {0};
+    append_temps(&declarations, main_temps);
+    fprintf(out, "%s", declarations.chars);
+    buffer_free(&declarations);
+    fprintf(out, "    init_scopes();\n");
+    fprintf(out, "    rt_start(scopes[0], %s);\n", function_count > 0 ? "bodies" : "NULL");
+    fprintf(out, "    init_nodes();\n");
+    if (main_uses_slots) {
+        fprintf(out, "    Value *slots = rt_slots();\n");
+    }
+    fprintf(out, "%s", main_body.chars);
+    fprintf(out, "    return rt_finish(t%d);\n}\n", result);
+
+    buffer_free(&main_body);
+    reset();
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include "utils/arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+/**
+ * Something outside the arena, like a compiled chunk, that has to be
+ * released when the arena is.
+ */
+struct ArenaCleanup {
+    ArenaCleanup *next;
+    void (*cleanup)(void *data);
+    void *data;
+};
+
+static ArenaBlock *add_block(Arena *arena, size_t size) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    block->used = 0;
+    block->size = size;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+/**
+ * @brief Create an empty arena.
+ * @return A pointer to the arena, released with arena_destroy().
+ */
+Arena *arena_create() {
+    Arena *arena = malloc(sizeof(Arena));
+    if (!arena) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    arena->blocks = NULL;
+    arena->cleanups = NULL;
+    return arena;
+}
+
+/**
+ * @brief Allocate uninitialised memory that lives as long as the arena.
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes needed.
+ * @return A pointer aligned for any type.
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->used + size > block->size) {
+        // Oversized requests get a block of their own
+        block = add_block(arena, size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+/**
+ * @brief Copy a string into the arena.
+ * @param chars The characters, which need not be null terminated.
+ * @param length The number of characters to copy.
+ * @return The null terminated copy.
+ */
+char *arena_strndup(Arena *arena, const char *chars, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, chars, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * @brief Register a function to run when the arena is destroyed, before
+ *        its memory is released.
+ * @param cleanup The function to call.
+ * @param data The argument to call it with.
+ */
+void arena_defer(Arena *arena, void (*cleanup)(void *data), void *data) {
+    ArenaCleanup *entry = arena_alloc(arena, sizeof(ArenaCleanup));
+    entry->cleanup = cleanup;
+    entry->data = data;
+    entry->next = arena->cleanups;
+    arena->cleanups = entry;
+}
+
+/**
+ * @brief Run the deferred cleanups, then free every block of the arena.
+ * @param arena The arena to destroy.
+ */
+void arena_destroy(Arena *arena) {
+    if (!arena) return;
+
+    for (ArenaCleanup *entry = arena->cleanups; entry != NULL; entry = entry->next) {
+        entry->cleanup(entry->data);
+    }
+
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
\ No newline at end of file
@@ -1,60 +1,242 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/resource.h>
 #include "utils/hash_table.h"
+#include "utils/call_stack.h"
+#include "resolver.h"
+#include "garbage_collector.h"
 #include "token.h"
+#include "features/object.h"
 
-#define MAX_FRAMES 32
+#define FRAMES_INITIAL_CAPACITY 32
 
-typedef struct StackFrame {
-    char *caller;
-    HashTable *local_variables;
-    int status;
-} StackFrame;
+// Frames released by frame_destroy, reused with their slots by the next call
+static StackFrame *frame_pool = NULL;
+static int max_depth = DEFAULT_MAX_DEPTH;
 
-typedef struct CallStack {
-    StackFrame **frames;
-    int top;
-} CallStack;
+// The evaluator recurses natively once per call, so pushes also stop before
+// the native stack runs out, whatever --max-depth allows
+#define NATIVE_STACK_RESERVE (256 * 1024)
+static uintptr_t native_stack_base = 0;
+static size_t native_stack_limit = 0;   // Bytes pushes may use, 0 if unlimited
+
+/**
+ * @brief Give a frame slot_count empty slots, growing its slot array if needed.
+ */
+static void frame_prepare(StackFrame *frame, char *name, int slot_count) {
+    if (slot_count > frame->capacity) {
+        frame->slots = realloc(frame->slots, slot_count * sizeof(Value));
+        if (!frame->slots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        frame->capacity = slot_count;
+    }
+    for (int i = 0; i < slot_count; i++) {
+        frame->slots[i] = UNDEFINED_VAL;
+    }
 
-StackFrame *frame_create(char *name) {
-    StackFrame* frame = malloc(sizeof(StackFrame));
-    if (!frame) return NULL;
     frame->caller = name;
-    frame->local_variables = hashtable_create(32);
+    frame->scope = NULL;
+    frame->local_variables = NULL;
+    frame->object = NULL;
     frame->status = 0;
+    frame->next = NULL;
+}
+
+/**
+ * @brief Take a frame from the pool, or allocate one if it is empty.
+ * @param name The name of the caller, for stack traces.
+ * @param slot_count The number of slots the frame needs.
+ * @return A frame with slot_count slots set to UNDEFINED_VAL.
+ */
+static StackFrame *frame_acquire(char *name, int slot_count) {
+    StackFrame *frame = frame_pool;
+    if (frame != NULL) {
+        frame_pool = frame->next;
+    } else {
+        frame = malloc(sizeof(StackFrame));
+        if (!frame) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        frame->slots = NULL;
+        frame->capacity = 0;
+    }
+    frame_prepare(frame, name, slot_count);
+    return frame;
+}
+
+static void frame_free(StackFrame *frame) {
+    free(frame->slots);
+    free(frame);
+}
+
+/**
+ * @brief Create a frame with one empty slot per variable of the scope.
+ * @param name The name of the caller, for stack traces.
+ * @param scope The scope of the code run in the frame, or NULL.
+ * @return A pointer to the frame.
+ */
+StackFrame *frame_create(char *name, Scope *scope) {
+    StackFrame *frame = frame_acquire(name, scope != NULL ? scope->count : 0);
+    frame->scope = scope;
     return frame;
 } 
 
 StackFrame *frame_create_with_variables(char *name, HashTable *table) {
-    StackFrame* frame = malloc(sizeof(StackFrame));
-    if (!frame) return NULL;
-    frame->caller = name;
+    StackFrame *frame = frame_acquire(name, 0);
     frame->local_variables = table;
-    frame->status = 0;
     return frame;
 } 
 
+/**
+ * @brief Create a frame binding the fields of an object, for the class body
+ *        and methods run on it.
+ * @param name The name of the caller, for stack traces.
+ * @param object The object, kept reachable by the frame.
+ * @return A pointer to the frame.
+ */
+StackFrame *frame_create_for_object(char *name, Obj *object) {
+    StackFrame *frame = frame_acquire(name, 0);
+    frame->object = object;
+    return frame;
+}
+
+/**
+ * @brief Empty a frame on the stack so it runs another scope, for a call in
+ *        tail position that takes the place of its caller.
+ * @param frame The frame to reuse, which owns its variables without a slot.
+ * @param name The name of the new caller, for stack traces.
+ * @param scope The scope of the code now run in the frame.
+ */
+void frame_reset(StackFrame *frame, char *name, Scope *scope) {
+    if (frame->local_variables) {
+        hashtable_destroy(frame->local_variables);
+    }
+    frame_prepare(frame, name, scope != NULL ? scope->count : 0);
+    frame->scope = scope;
+}
+
+/**
+ * @brief Release a frame to the pool, keeping its slots for the next call.
+ * @param destroy_hashtable Whether the frame owns its variables without a slot.
+ */
 void frame_destroy(StackFrame *frame, bool destroy_hashtable) {
-    if (destroy_hashtable) {
+    if (destroy_hashtable && frame->local_variables) {
         hashtable_destroy(frame->local_variables);
     }
-    free(frame);
+    frame->local_variables = NULL;
+    frame->next = frame_pool;
+    frame_pool = frame;
+}
+
+/**
+ * @brief Get a variable of a frame by name, checking its slots first.
+ * @return Status of 1 if found and 0 if not.
+ */
+int frame_get(StackFrame *frame, const char *key, Value *out_value) {
+    int slot = scope_find(frame->scope, key);
+    if (slot >= 0 && !IS_UNDEFINED(frame->slots[slot])) {
+        *out_value = frame->slots[slot];
+        return 1;
+    }
+    if (frame->object != NULL) {
+        return object_get_field(frame->object, key, out_value);
+    }
+    return hashtable_get(frame->local_variables, key, out_value);
+}
+
+/**
+ * @brief Bind a variable of a frame by name, using its slot if it has one.
+ */
+void frame_set(StackFrame *frame, char *key, Value value) {
+    int slot = scope_find(frame->scope, key);
+    if (slot >= 0) {
+        frame_set_slot(frame, slot, value);
+        return;
+    }
+    if (frame->object != NULL) {
+        object_set_field(frame->object, key, value);
+        return;
+    }
+    if (frame->local_variables == NULL) {
+        frame->local_variables = hashtable_create(0);
+    }
+    hashtable_set(frame->local_variables, key, value);
+}
+
+void frame_set_slot(StackFrame *frame, int slot, Value value) {
+    frame->slots[slot] = value;
+}
+
+/**
+ * @brief Set the number of frames, including main, past which a push overflows.
+ */
+void stack_set_max_depth(int depth) {
+    max_depth = depth;
+}
+
+/**
+ * @brief Note where the native stack stands and how far it may grow, for
+ *        stack_push() to stop deep calls before they overflow it.
+ */
+static void native_stack_init() {
+    char marker;
+    native_stack_base = (uintptr_t)&marker;
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        native_stack_limit = 0;
+    } else if (limit.rlim_cur > 2 * NATIVE_STACK_RESERVE) {
+        native_stack_limit = limit.rlim_cur - NATIVE_STACK_RESERVE;
+    } else {
+        native_stack_limit = limit.rlim_cur / 2;
+    }
+}
+
+static size_t native_stack_used() {
+    char marker;
+    uintptr_t here = (uintptr_t)&marker;
+    return here < native_stack_base ? native_stack_base - here : here - native_stack_base;
 }
 
 void stack_init(CallStack *stack) {
-    stack->frames = malloc(sizeof(StackFrame*) * MAX_FRAMES);
+    native_stack_init();
+    stack->capacity = FRAMES_INITIAL_CAPACITY;
+    stack->frames = malloc(sizeof(StackFrame*) * stack->capacity);
+    if (!stack->frames) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
     stack->top = -1;
 }
 
+/**
+ * @brief Push a frame, doubling the stack when it is full.
+ *        Exits once the stack is max_depth frames deep, or the native
+ *        stack is close to its limit.
+ */
 void stack_push(CallStack *stack, StackFrame *frame) {
-    // TODO: free any stackframe that may be overwitten
-    if (stack->top + 1 < MAX_FRAMES) {
-        stack->frames[++stack->top] = frame;
-    } else {
-        fprintf(stderr, "Stack Overflow!!!\n");
+    if (stack->top + 1 >= max_depth) {
+        fprintf(stderr, "Stack Overflow!!! Calls are nested deeper than %d, see --max-depth\n", max_depth);
+        exit(1);
+    }
+    if (native_stack_limit != 0 && native_stack_used() > native_stack_limit) {
+        fprintf(stderr, "Stack Overflow!!! Calls nested %d deep exhaust the native stack, see ulimit -s\n", stack->top + 1);
         exit(1);
     }
+    if (stack->top + 1 == stack->capacity) {
+        stack->capacity *= 2;
+        stack->frames = realloc(stack->frames, sizeof(StackFrame*) * stack->capacity);
+        if (!stack->frames) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    stack->frames[++stack->top] = frame;
 }
 
 StackFrame *stack_pop(CallStack *stack) {
@@ -71,16 +253,64 @@ StackFrame *stack_peek(CallStack *stack) {
 }
 
 // Descend stack to get all
-int stack_get_value(CallStack *stack, const char *key, Value **out_value) {
+int stack_get_value(CallStack *stack, const char *key, Value *out_value) {
     for (int i = stack->top; i >= 0; i--) {
-        int found = hashtable_get(stack->frames[i]->local_variables, key, out_value);
-        if (found && out_value != NULL) {
+        int found = frame_get(stack->frames[i], key, out_value);
+        if (found) {
             return 1;
         }
     }
     return 0;
 }
 
+/**
+ * @brief Get a variable the resolver gave a slot. Reads the slot directly when
+ *        the frame on top runs the scope, or the global slot when no frame above
+ *        main can bind the name. Otherwise descends the stack by name.
+ * @param stack The call stack.
+ * @param scope The scope the variable was resolved to, NULL if unresolved.
+ * @param slot The slot within the scope, -1 if unresolved.
+ * @param key The interned variable name.
+ * @param out_value A pointer to the value of the variable.
+ * @return Status of 1 if found and 0 if not.
+ */
+int stack_lookup(CallStack *stack, Scope *scope, int slot, const char *key, Value *out_value) {
+    if (slot >= 0) {
+        StackFrame *top = stack->frames[stack->top];
+        StackFrame *main = stack->frames[0];
+        Value value = UNDEFINED_VAL;
+
+        if (top->scope == scope) {
+            value = top->slots[slot];
+        } else if (main->scope == scope && !scope->shadowed[slot]) {
+            value = main->slots[slot];
+        }
+
+        if (!IS_UNDEFINED(value)) {
+            *out_value = value;
+            return 1;
+        }
+    }
+    return stack_get_value(stack, key, out_value);
+}
+
+/**
+ * @brief Bind a variable in the frame on top of the stack.
+ * @param stack The call stack.
+ * @param scope The scope the variable was resolved to, NULL if unresolved.
+ * @param slot The slot within the scope, -1 if unresolved.
+ * @param key The interned variable name.
+ * @param value The value to bind.
+ */
+void stack_assign(CallStack *stack, Scope *scope, int slot, char *key, Value value) {
+    StackFrame *top = stack->frames[stack->top];
+    if (slot >= 0 && top->scope == scope) {
+        frame_set_slot(top, slot, value);
+    } else {
+        frame_set(top, key, value);
+    }
+}
+
 void stack_destroy(CallStack *stack) {
     if (stack == NULL) {
         return;
@@ -92,6 +322,12 @@ void stack_destroy(CallStack *stack) {
         }
     }
 
+    while (frame_pool != NULL) {
+        StackFrame *frame = frame_pool;
+        frame_pool = frame->next;
+        frame_free(frame);
+    }
+
     free(stack->frames);
     free(stack);
 }
@@ -1,5 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /**
  * read_file - Reads all the text in a given file
@@ -40,6 +44,57 @@ char* read_file(char* name) {
     return buffer;
 }
 
+/**
+ * map_file - Maps a file into memory instead of copying it. The page the
+ *            file ends in is zero filled, which terminates the text. When
+ *            the file fills its last page exactly it is read instead.
+ * 
+ * @param name The filename to map
+ * @param mapped_length Set to the length of the mapping, or 0 if the file
+ *                      was read into the heap
+ * 
+ * @return The read only text of the file, released with unmap_file()
+ */
+char* map_file(char *name, size_t *mapped_length) {
+    *mapped_length = 0;
+
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open: %s\n", name);
+        return NULL;
+    }
+
+    struct stat info;
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (fstat(fd, &info) != 0 || info.st_size == 0 || info.st_size % page_size == 0) {
+        close(fd);
+        return read_file(name);
+    }
+
+    char *text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        return read_file(name);
+    }
+
+    *mapped_length = info.st_size;
+    return text;
+}
+
+/**
+ * unmap_file - Releases the text returned by map_file()
+ * 
+ * @param text The text of the file
+ * @param mapped_length The length set by map_file()
+ */
+void unmap_file(char *text, size_t mapped_length) {
+    if (mapped_length > 0) {
+        munmap(text, mapped_length);
+    } else {
+        free(text);
+    }
+}
+
 /**
  * write_file - Writes text into the given file
  * 
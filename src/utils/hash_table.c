@@ -1,107 +1,41 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>
 #include "token.h"
-#include "garbage_collector.h"
-
-typedef struct Pair {
-    char *key;
-    Value *value;
-    struct Pair *next;
-} Pair;
-
-typedef struct HashTable {
-    size_t size;
-    Pair **buckets;
-} HashTable;
-
-/**
- * @brief djb2 hash function.
- * @param key The value to be hashed.
- * @param size The max size the return value can be.
- * @return The hashed key.
- */
-static unsigned int hash(const char* key, size_t size) {
-    unsigned int hash = 5381;
-    int c;
-
-    while ((c = *key++))
-        hash = ((hash << 5) + hash) + c;
-
-    return hash % size;
-}
+#include "utils/hash_table.h"
 
 /**
- * @brief Create a hashtable with a given number of buckets.
- * @param size The number of buckets in the hash table.
+ * @brief Create a hashtable with room for a given number of variables.
+ * @param size The number of entries to make room for, the table grows past it.
  * @return A pointer to the hash table.
  */
 HashTable *hashtable_create(size_t size) {
     HashTable* table = malloc(sizeof(HashTable));
     if (!table) return NULL;
-    table->size = size;
-    table->buckets = calloc(size, sizeof(Pair*));
-    if (!table->buckets) {
-        free(table);
-        return NULL;
-    }
+    table_init(&table->table, size);
     return table;
 }
 
 /**
  * @brief Set a key value pair of a hash table.
  * @param table A pointer to the hash table to add to.
- * @param key The key string.
+ * @param key The key string, which must be interned.
  * @param value The value associated with the key.
  */
-void hashtable_set(HashTable *table, char *key, Value *value) {
-    if (value == NULL) {
-        printf("Attempted to assign null to key: %s\n", key);
-    }
-
-    gc_reference(value);
-
-    unsigned int pos = hash(key, table->size);
-    Pair *entry = table->buckets[pos];
-
-    while (entry) {
-        // Identical key: update value
-        if (strcmp(entry->key, key) == 0) {
-            entry->value = value;
-            return;
-        }
-        // Collision: append entry to linked list
-        entry = entry->next;
-    }
-
-    // No collision: add entry at that position
-    Pair *new_entry = malloc(sizeof(Pair));
-    new_entry->key = strdup(key);
-    new_entry->value = value;
-    new_entry->next = table->buckets[pos];
-    table->buckets[pos] = new_entry;
+void hashtable_set(HashTable *table, char *key, Value value) {
+    table_set(&table->table, key, value);
 }
 
 /**
  * @brief Get the value of the hashtable at the key and a status code.
  *        "Proper" return value is the out_value.   
  * @param table A pointer to the hash table to get from.
- * @param key The key from which to get the value.
+ * @param key The key from which to get the value, which must be interned.
  * @param out_value A pointer to the value at the key.
  * @return Status of 1 if successful and 0 if not.
  */
-int hashtable_get(HashTable *table, const char *key, Value **out_value) {
+int hashtable_get(HashTable *table, const char *key, Value *out_value) {
     if (!table) return 0;
-    unsigned int pos = hash(key, table->size);
-    Pair *entry = table->buckets[pos];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            *out_value = entry->value;
-            return 1;
-        }
-        entry = entry->next;
-    }
-    return 0;
+    return table_get(&table->table, key, out_value);
 }
 
 /**
@@ -110,16 +44,6 @@ int hashtable_get(HashTable *table, const char *key, Value **out_value) {
  */
 void hashtable_destroy(HashTable *table) {
     if (!table) return;
-    for (size_t i = 0; i < table->size; i++) {
-        Pair *entry = table->buckets[i];
-        while (entry) {
-            Pair *next = entry->next;
-            free(entry->key);
-            gc_dereference(entry->value);
-            free(entry);
-            entry = next;
-        }
-    }
-    free(table->buckets);
+    table_free(&table->table);
     free(table);
 }
\ No newline at end of file
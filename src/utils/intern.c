@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/intern.h"
+
+#define INTERN_MIN_CAPACITY 256
+
+/**
+ * Every interned string in the process, open addressed by hash. Symbols are
+ * never removed, they live until intern_free_all() at exit.
+ */
+typedef struct InternTable {
+    Symbol **symbols;
+    size_t count;
+    size_t capacity;
+} InternTable;
+
+InternTable interned = { NULL, 0, 0 };
+
+/**
+ * @brief djb2 hash function.
+ * @param chars The characters to be hashed.
+ * @param length The number of characters.
+ * @return The hashed string, reduced by the caller.
+ */
+unsigned int hash_string(const char *chars, int length) {
+    unsigned int hash = 5381;
+
+    for (int i = 0; i < length; i++)
+        hash = ((hash << 5) + hash) + (unsigned char)chars[i];
+
+    return hash;
+}
+
+static Symbol **find_slot(Symbol **symbols, size_t capacity, const char *chars, int length, unsigned int hash) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Symbol *symbol = symbols[i];
+        if (symbol == NULL) return &symbols[i];
+        if (symbol->hash == hash && symbol->length == length && memcmp(symbol->chars, chars, length) == 0) {
+            return &symbols[i];
+        }
+    }
+}
+
+static void grow() {
+    size_t capacity = interned.capacity < INTERN_MIN_CAPACITY ? INTERN_MIN_CAPACITY : interned.capacity * 2;
+    Symbol **symbols = calloc(capacity, sizeof(Symbol*));
+    if (!symbols) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < interned.capacity; i++) {
+        Symbol *symbol = interned.symbols[i];
+        if (symbol == NULL) continue;
+        *find_slot(symbols, capacity, symbol->chars, symbol->length, symbol->hash) = symbol;
+    }
+
+    free(interned.symbols);
+    interned.symbols = symbols;
+    interned.capacity = capacity;
+}
+
+/**
+ * @brief Copy a string into a symbol of its own, outside the intern table.
+ *        Tables that own their keys use these, as their characters can be
+ *        freed, and compare them by characters rather than by pointer.
+ * @param chars The characters, which need not be null terminated.
+ * @param length The number of characters.
+ * @return The characters of the symbol, to be freed with symbol_free().
+ */
+char *symbol_create(const char *chars, int length) {
+    Symbol *symbol = malloc(sizeof(Symbol) + length + 1);
+    if (!symbol) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    symbol->hash = hash_string(chars, length);
+    symbol->length = length;
+    memcpy(symbol->chars, chars, length);
+    symbol->chars[length] = '\0';
+    return symbol->chars;
+}
+
+void symbol_free(char *name) {
+    if (name != NULL) free(SYMBOL(name));
+}
+
+/**
+ * @brief Get the canonical copy of a string, adding it if it is new.
+ * @param chars The characters, which need not be null terminated.
+ * @param length The number of characters.
+ * @return The interned string, which must not be modified or freed.
+ */
+char *intern(const char *chars, int length) {
+    if ((interned.count + 1) * 2 > interned.capacity) {
+        grow();
+    }
+
+    unsigned int hash = hash_string(chars, length);
+    Symbol **slot = find_slot(interned.symbols, interned.capacity, chars, length, hash);
+    if (*slot != NULL) return (*slot)->chars;
+
+    char *name = symbol_create(chars, length);
+    *slot = SYMBOL(name);
+    interned.count++;
+    return name;
+}
+
+char *intern_string(const char *string) {
+    return intern(string, strlen(string));
+}
+
+/**
+ * @brief Get the canonical copy of a string without adding it.
+ * @return The interned string, or NULL if it has never been interned.
+ */
+char *intern_find(const char *chars, int length) {
+    if (interned.count == 0) return NULL;
+
+    Symbol *symbol = *find_slot(interned.symbols, interned.capacity, chars, length, hash_string(chars, length));
+    return symbol != NULL ? symbol->chars : NULL;
+}
+
+/**
+ * @brief Free every interned string. Used at exit.
+ */
+void intern_free_all() {
+    for (size_t i = 0; i < interned.capacity; i++) {
+        free(interned.symbols[i]);
+    }
+    free(interned.symbols);
+    interned.symbols = NULL;
+    interned.count = 0;
+    interned.capacity = 0;
+}
\ No newline at end of file
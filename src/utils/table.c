@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils/table.h"
+#include "utils/intern.h"
+
+#define TABLE_MIN_CAPACITY 8
+
+#define IS_EMPTY(entry) ((entry)->key == NULL && IS_NONE((entry)->value))
+#define IS_TOMBSTONE(entry) ((entry)->key == NULL && !IS_NONE((entry)->value))
+
+static Entry *allocate_entries(size_t capacity) {
+    Entry *entries = malloc(capacity * sizeof(Entry));
+    if (!entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        entries[i].key = NULL;
+        entries[i].value = NONE_VAL;
+    }
+    return entries;
+}
+
+/**
+ * @brief Find the slot of a key, or the slot it should be inserted into.
+ *        Reuses the first tombstone passed on the way to an empty slot.
+ */
+static Entry *find_entry(Entry *entries, size_t capacity, const char *key) {
+    size_t mask = capacity - 1;
+    Entry *tombstone = NULL;
+
+    for (size_t i = SYMBOL_HASH(key) & mask; ; i = (i + 1) & mask) {
+        Entry *entry = &entries[i];
+        if (entry->key == NULL) {
+            if (IS_EMPTY(entry)) {
+                return tombstone != NULL ? tombstone : entry;
+            }
+            if (tombstone == NULL) tombstone = entry;
+        } else if (entry->key == key) {
+            return entry;
+        }
+    }
+}
+
+/**
+ * @brief Move every live entry into a new array, dropping tombstones.
+ */
+static void resize(Table *table, size_t capacity) {
+    Entry *entries = allocate_entries(capacity);
+    for (size_t i = 0; i < table->capacity; i++) {
+        Entry *entry = &table->entries[i];
+        if (entry->key == NULL) continue;
+
+        Entry *destination = find_entry(entries, capacity, entry->key);
+        *destination = *entry;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    table->tombstones = 0;
+}
+
+/**
+ * @brief Initialise an empty table.
+ * @param table The table to initialise.
+ * @param expected How many entries to make room for, 0 to allocate on first use.
+ */
+void table_init(Table *table, size_t expected) {
+    table->count = 0;
+    table->tombstones = 0;
+    table->capacity = 0;
+    table->entries = NULL;
+
+    if (expected > 0) {
+        size_t capacity = TABLE_MIN_CAPACITY;
+        while (expected * 4 > capacity * 3) {
+            capacity *= 2;
+        }
+        table->entries = allocate_entries(capacity);
+        table->capacity = capacity;
+    }
+}
+
+/**
+ * @brief Free the entries of a table. The keys belong to the intern table, or
+ *        to the owner of the table, and the values to the collector.
+ * @param table The table to free.
+ */
+void table_free(Table *table) {
+    free(table->entries);
+    table_init(table, 0);
+}
+
+/**
+ * @brief Get the value at a key.
+ * @param table The table to search.
+ * @param key The interned key string.
+ * @param out_value A pointer to the value at the key.
+ * @return true if the key was found.
+ */
+bool table_get(Table *table, const char *key, Value *out_value) {
+    if (table->count == 0) return false;
+
+    Entry *entry = find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL) return false;
+
+    *out_value = entry->value;
+    return true;
+}
+
+/**
+ * @brief Find a key by its characters, for tables whose keys are symbols of
+ *        their own rather than interned, so equal keys may not share a pointer.
+ * @param table The table to search.
+ * @param chars The characters of the key.
+ * @param length The number of characters.
+ * @return The key held by the table, or NULL if there is none.
+ */
+const char *table_find_key(Table *table, const char *chars, int length) {
+    if (table->count == 0) return NULL;
+
+    unsigned int hash = hash_string(chars, length);
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Entry *entry = &table->entries[i];
+        if (entry->key == NULL) {
+            if (IS_EMPTY(entry)) return NULL;
+            continue;
+        }
+        Symbol *symbol = SYMBOL(entry->key);
+        if (symbol->hash == hash && symbol->length == length && memcmp(symbol->chars, chars, length) == 0) {
+            return entry->key;
+        }
+    }
+}
+
+/**
+ * @brief Set the value at a key.
+ * @param table The table to add to.
+ * @param key The interned key string.
+ * @param value The value associated with the key.
+ */
+void table_set(Table *table, const char *key, Value value) {
+    if ((table->count + table->tombstones + 1) * 4 > table->capacity * 3) {
+        // Rehashing in place is enough when tombstones fill the table
+        size_t capacity = table->capacity < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY : table->capacity;
+        if ((table->count + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+        resize(table, capacity);
+    }
+
+    Entry *entry = find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL) {
+        if (IS_TOMBSTONE(entry)) table->tombstones--;
+        entry->key = key;
+        table->count++;
+    }
+    entry->value = value;
+}
+
+/**
+ * @brief Remove a key, shrinking the table once it is under a quarter full.
+ * @param table The table to remove from.
+ * @param key The interned key string.
+ * @return true if the key was found.
+ */
+bool table_delete(Table *table, const char *key) {
+    if (table->count == 0) return false;
+
+    Entry *entry = find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL) return false;
+
+    entry->key = NULL;
+    entry->value = TRUE_VAL;
+    table->count--;
+    table->tombstones++;
+
+    if (table->capacity > TABLE_MIN_CAPACITY && table->count * 4 < table->capacity) {
+        resize(table, table->capacity / 2);
+    }
+    return true;
+}
@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "token.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "evaluator.h"
+#include "vm.h"
+#include "utils/hash_table.h"
+#include "utils/call_stack.h"
+#include "utils/intern.h"
+#include "features/list.h"
+#include "features/hashmap.h"
+#include "features/object.h"
+#include "garbage_collector.h"
+
+#define STACK_INITIAL_CAPACITY 256
+#define FRAMES_INITIAL_CAPACITY 16
+
+typedef enum {
+    FRAME_SCRIPT,
+    FRAME_IMPORT,
+    FRAME_FUNCTION,
+    FRAME_METHOD,
+    FRAME_CONSTRUCTOR
+} FrameKind;
+
+/**
+ * A frame of bytecode execution. Variables still live in the shared CallStack,
+ * this only tracks where to resume and which part of the value stack is owned.
+ */
+typedef struct VMFrame {
+    Chunk *chunk;
+    uint8_t *ip;
+    int base;       // Stack slot the result is written to on return
+    FrameKind kind;
+} VMFrame;
+
+typedef struct VM {
+    Value *stack;
+    int stack_top;
+    int stack_capacity;
+
+    VMFrame *frames;
+    int frame_count;
+    int frame_capacity;
+} VM;
+
+VM vm;
+bool vm_debug_mode = false;
+
+void set_debug_mode_vm(bool debug) {
+    vm_debug_mode = debug;
+}
+
+static void push(Value value) {
+    if (vm.stack_top + 1 > vm.stack_capacity) {
+        vm.stack_capacity *= 2;
+        vm.stack = realloc(vm.stack, vm.stack_capacity * sizeof(Value));
+        if (!vm.stack) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    vm.stack[vm.stack_top++] = value;
+}
+
+static Value pop() {
+    return vm.stack[--vm.stack_top];
+}
+
+static Value peek(int distance) {
+    return vm.stack[vm.stack_top - 1 - distance];
+}
+
+static VMFrame *push_frame(Chunk *chunk, int base, FrameKind kind) {
+    if (vm.frame_count + 1 > vm.frame_capacity) {
+        vm.frame_capacity *= 2;
+        vm.frames = realloc(vm.frames, vm.frame_capacity * sizeof(VMFrame));
+        if (!vm.frames) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    VMFrame *frame = &vm.frames[vm.frame_count++];
+    frame->chunk = chunk;
+    frame->ip = chunk->code;
+    frame->base = base;
+    frame->kind = kind;
+    return frame;
+}
+
+static bool is_callable(Value value) {
+    if (!IS_OBJ(value)) return false;
+    ValueType type = value_type(value);
+    return type == TYPE_FUNCTION || type == TYPE_NATIVE || type == TYPE_CLASS;
+}
+
+/**
+ * @brief The slots the LOCAL operands of a frame index directly.
+ * @return NULL while the frame on top of the call stack is not the one the
+ *         chunk binds in, such as while the arguments of a method call run
+ *         above the frames of its object, so variables are looked up instead.
+ */
+static Value *frame_locals(VMFrame *frame) {
+    StackFrame *top = stack_peek(callStack);
+    return top->scope != NULL && top->scope == frame->chunk->scope ? top->slots : NULL;
+}
+
+/**
+ * @brief Look a variable up through the call stack, for accesses the slots
+ *        of the running frame or of main cannot answer.
+ */
+static Value lookup_variable(ParseNode *identifier, Scope *scope, int slot) {
+    Value value;
+    if (!stack_lookup(callStack, scope, slot, node_name(identifier), &value)) {
+        error_and_exit(identifier, "Identifier not yet declared");
+    }
+    return value;
+}
+
+/**
+ * @brief Bind the arguments on top of the stack to the parameters of a definition.
+ *        Like execute_function(), surplus arguments or parameters are ignored.
+ *        Object fields are bound by name, function parameters by slot.
+ */
+static void bind_arguments(StackFrame *frame, ParseNode *params, int first_arg, int argc) {
+    for (int i = 0; i < params->item_count && i < argc; i++) {
+        ParseNode *param = node_item(params, i);
+        if (frame->scope == NULL) {
+            frame_set(frame, node_name(param), vm.stack[first_arg + i]);
+        } else {
+            frame_set_slot(frame, param->slot, vm.stack[first_arg + i]);
+        }
+    }
+}
+
+/**
+ * @brief Call the function, builtin or class below argc arguments on the stack.
+ * @param node The node naming the call, used as the name of the new stack frame.
+ * @param argc The number of arguments on the stack.
+ * @param kind FRAME_METHOD if the callee was pushed by BC_MEMBER.
+ * @return The frame to continue executing.
+ */
+static VMFrame *call_value(ParseNode *node, int argc, FrameKind kind) {
+    int callee_slot = vm.stack_top - argc - 1;
+    Value callee = vm.stack[callee_slot];
+
+    // Builtins run to completion, their result replaces the callee
+    if (value_type(callee) == TYPE_NATIVE) {
+        Value result = AS_NATIVE(callee)(node, &vm.stack[callee_slot + 1], argc);
+        vm.stack_top = callee_slot;
+        push(result);
+        return &vm.frames[vm.frame_count - 1];
+    }
+
+    ParseNode *definition = AS_NODE(callee);
+    ParseNode *params = node_left(definition);
+
+    StackFrame *frame;
+    if (value_type(callee) == TYPE_CLASS) {
+        // The class body fills in the fields of a new object through its
+        // frame, above the methods of the class
+        Obj *object = AS_OBJ(object_create(node_shape(definition)));
+        stack_push(callStack, frame_create_with_variables(node_name(node), node_shape(definition)->methods));
+        frame = frame_create_for_object(node_name(node), object);
+        kind = FRAME_CONSTRUCTOR;
+    } else {
+        frame = frame_create(node_name(node), node_scope(definition));
+    }
+    bind_arguments(frame, params, callee_slot + 1, argc);
+    stack_push(callStack, frame);
+
+    // A method result also replaces the object below the callee
+    int base = kind == FRAME_METHOD ? callee_slot - 1 : callee_slot;
+    vm.stack_top = base;
+    return push_frame(compile_body(definition), base, kind);
+}
+
+/**
+ * @brief Call the function below argc arguments on the stack in place of the
+ *        function running in frame, reusing its frames. Classes, and calls
+ *        from frames that are not a function's, get frames of their own.
+ * @return The frame to continue executing.
+ */
+static VMFrame *tail_call_value(ParseNode *node, int argc, VMFrame *frame) {
+    int callee_slot = vm.stack_top - argc - 1;
+    Value callee = vm.stack[callee_slot];
+    if (value_type(callee) != TYPE_FUNCTION
+        || (frame->kind != FRAME_FUNCTION && frame->kind != FRAME_METHOD)) {
+        return call_value(node, argc, FRAME_FUNCTION);
+    }
+
+    ParseNode *definition = AS_NODE(callee);
+    StackFrame *variables = stack_peek(callStack);
+    frame_reset(variables, node_name(node), node_scope(definition));
+    bind_arguments(variables, node_left(definition), callee_slot + 1, argc);
+
+    // The result still goes where the caller's would have
+    vm.stack_top = frame->base;
+    frame->chunk = compile_body(definition);
+    frame->ip = frame->chunk->code;
+    return frame;
+}
+
+static VMFrame *import_file(ParseNode *node) {
+    if (node_code(node) == NULL) {
+        node_set_code(node, compile(load_import(node)));
+    }
+    return push_frame(node_code(node), vm.stack_top, FRAME_IMPORT);
+}
+
+static Value build_list(int count) {
+    // Allocated while the items are still on the stack
+    Obj *list_value = gc_malloc();
+    List *list = list_create(count);
+    for (int i = vm.stack_top - count; i < vm.stack_top; i++) {
+        list_add(list, vm.stack[i]);
+    }
+    vm.stack_top -= count;
+
+    list_value->type = TYPE_LIST;
+    list_value->data.list = list;
+    return OBJ_VAL(list_value);
+}
+
+static Value build_map(ParseNode *node, int count) {
+    // Allocated while the keys and values are still on the stack
+    Obj *map_value = gc_malloc();
+    HashMap *map = hashmap_create(count);
+    map_value->type = TYPE_MAP;
+    map_value->data.map = map;
+
+    int first = vm.stack_top - count * 2;
+    vm.stack_top = first;
+
+    for (int i = 0; i < count; i++) {
+        Value key = vm.stack[first + i * 2];
+        Value value = vm.stack[first + i * 2 + 1];
+        if (value_type(key) != TYPE_STRING) {
+            runtime_error(node, "Map key must be a string");
+            return NONE_VAL;
+        }
+        hashmap_set(map, AS_STRING(key), value);
+    }
+
+    if (vm_debug_mode) {
+        printf("Map created with %ld entries\n", map->table.count);
+    }
+
+    return OBJ_VAL(map_value);
+}
+
+/**
+ * @brief The dispatch loop. Runs until the script frame returns.
+ */
+static Value run() {
+    VMFrame *frame = &vm.frames[vm.frame_count - 1];
+    uint8_t *ip = frame->ip;
+    Value *locals = frame_locals(frame);
+    StackFrame *main_frame = callStack->frames[0];
+
+#define READ_OPERAND() (ip += sizeof(uint32_t), chunk_read_operand(ip - sizeof(uint32_t)))
+#define READ_NAME() (AS_STRING(frame->chunk->constants[READ_OPERAND()]))
+#define CURRENT_NODE() (frame->chunk->nodes[instruction - frame->chunk->code])
+// Taken after anything that may change the running frame or the call stack
+#define SWITCH_FRAME(next) (frame = (next), ip = frame->ip, locals = frame_locals(frame))
+#define BINARY(apply) \
+    do { \
+        Value right = pop(); \
+        Value left = pop(); \
+        push(apply(CURRENT_NODE(), left, right)); \
+    } while (0)
+// Two ints are worked on in place, anything else goes through the evaluator
+#define BINARY_INT(operator, box, apply) \
+    do { \
+        Value right = vm.stack[vm.stack_top - 1]; \
+        Value left = vm.stack[vm.stack_top - 2]; \
+        if (IS_INT(left) && IS_INT(right)) { \
+            vm.stack[vm.stack_top - 2] = box(AS_INT(left) operator AS_INT(right)); \
+            vm.stack_top--; \
+        } else { \
+            BINARY(apply); \
+        } \
+    } while (0)
+
+    while (true) {
+        uint8_t *instruction = ip;
+        switch (*ip++) {
+            case BC_CONSTANT:
+                push(frame->chunk->constants[READ_OPERAND()]);
+                break;
+            case BC_NONE:
+                push(NONE_VAL);
+                break;
+            case BC_POP:
+                vm.stack_top--;
+                break;
+
+            case BC_GET_LOCAL: {
+                uint32_t slot = READ_OPERAND();
+                Value value = locals != NULL ? locals[slot] : UNDEFINED_VAL;
+                if (IS_UNDEFINED(value)) {
+                    value = lookup_variable(CURRENT_NODE(), frame->chunk->scope, slot);
+                }
+                push(value);
+                break;
+            }
+            case BC_GET_GLOBAL: {
+                uint32_t slot = READ_OPERAND();
+                Value value = main_frame->scope->shadowed[slot] ? UNDEFINED_VAL : main_frame->slots[slot];
+                if (IS_UNDEFINED(value)) {
+                    value = lookup_variable(CURRENT_NODE(), main_frame->scope, slot);
+                }
+                push(value);
+                break;
+            }
+            case BC_GET_NAME:
+                READ_OPERAND();
+                push(lookup_variable(CURRENT_NODE(), NULL, -1));
+                break;
+
+            case BC_LOAD_LOCAL:
+            case BC_LOAD_GLOBAL:
+            case BC_LOAD_NAME: {
+                OpCode op = *instruction;
+                uint32_t slot = READ_OPERAND();
+                ParseNode *identifier = CURRENT_NODE();
+
+                Value value = UNDEFINED_VAL;
+                Scope *scope = NULL;
+                if (op == BC_LOAD_LOCAL) {
+                    scope = frame->chunk->scope;
+                    if (locals != NULL) value = locals[slot];
+                } else if (op == BC_LOAD_GLOBAL) {
+                    scope = main_frame->scope;
+                    if (!scope->shadowed[slot]) value = main_frame->slots[slot];
+                }
+                if (IS_UNDEFINED(value)) {
+                    value = lookup_variable(identifier, scope, scope != NULL ? (int)slot : -1);
+                }
+                push(value);
+
+                if (is_callable(value)) {
+                    frame->ip = ip;
+                    SWITCH_FRAME(call_value(identifier, 0, FRAME_FUNCTION));
+                }
+                break;
+            }
+            case BC_SET_LOCAL: {
+                uint32_t slot = READ_OPERAND();
+                if (locals != NULL) {
+                    locals[slot] = peek(0);
+                } else {
+                    stack_assign(callStack, frame->chunk->scope, slot, node_name(CURRENT_NODE()), peek(0));
+                }
+                break;
+            }
+            case BC_SET_NAME:
+                stack_assign(callStack, NULL, -1, READ_NAME(), peek(0));
+                break;
+            case BC_SET_FIELD:
+                READ_OPERAND();
+                push(apply_set(CURRENT_NODE(), pop()));
+                break;
+
+            case BC_JUMP_IF_NOT_CALLABLE: {
+                uint32_t offset = READ_OPERAND();
+                if (!is_callable(peek(0))) ip += offset;
+                break;
+            }
+            case BC_CALL: {
+                uint32_t argc = READ_OPERAND();
+                frame->ip = ip;
+                SWITCH_FRAME(call_value(CURRENT_NODE(), argc, FRAME_FUNCTION));
+                break;
+            }
+            case BC_TAIL_CALL: {
+                uint32_t argc = READ_OPERAND();
+                frame->ip = ip;
+                SWITCH_FRAME(tail_call_value(CURRENT_NODE(), argc, frame));
+                break;
+            }
+            case BC_MEMBER: {
+                char *name = READ_NAME();
+                uint32_t offset = READ_OPERAND();
+                Value obj = peek(0);
+                if (value_type(obj) != TYPE_OBJECT) {
+                    runtime_error(CURRENT_NODE(), "Dot operator on non-object");
+                    vm.stack[vm.stack_top - 1] = NONE_VAL;
+                    ip += offset;
+                    break;
+                }
+
+                Value member;
+                if (!object_member(CURRENT_NODE(), obj, name, &member)) {
+                    runtime_error(CURRENT_NODE(), "Invalid member for object");
+                    vm.stack[vm.stack_top - 1] = NONE_VAL;
+                    ip += offset;
+                    break;
+                }
+
+                if (value_type(member) == TYPE_FUNCTION) {
+                    // Methods run with the methods of the class and the object's fields in scope
+                    char *caller = node_name(CURRENT_NODE());
+                    stack_push(callStack, frame_create_with_variables(caller, AS_SHAPE(obj)->methods));
+                    stack_push(callStack, frame_create_for_object(caller, AS_OBJ(obj)));
+                    locals = NULL;
+                    push(member);
+                } else {
+                    vm.stack[vm.stack_top - 1] = member;
+                    ip += offset;
+                }
+                break;
+            }
+            case BC_CALL_METHOD: {
+                uint32_t argc = READ_OPERAND();
+                frame->ip = ip;
+                SWITCH_FRAME(call_value(CURRENT_NODE(), argc, FRAME_METHOD));
+                break;
+            }
+
+            case BC_ADD: BINARY_INT(+, INT_VAL, apply_op_add); break;
+            case BC_SUB: BINARY_INT(-, INT_VAL, apply_op_binary); break;
+            case BC_MUL: BINARY_INT(*, INT_VAL, apply_op_binary); break;
+            // A zero divisor traps just as the evaluator's own division does
+            case BC_DIV: BINARY_INT(/, INT_VAL, apply_op_binary); break;
+            case BC_MOD: BINARY_INT(%, INT_VAL, apply_op_binary); break;
+            case BC_GT: BINARY_INT(>, BOOL_VAL, apply_op_binary); break;
+            case BC_GTE: BINARY_INT(>=, BOOL_VAL, apply_op_binary); break;
+            case BC_LT: BINARY_INT(<, BOOL_VAL, apply_op_binary); break;
+            case BC_LTE: BINARY_INT(<=, BOOL_VAL, apply_op_binary); break;
+            case BC_EQ: BINARY_INT(==, BOOL_VAL, apply_op_eq); break;
+            case BC_NEQ: BINARY_INT(!=, BOOL_VAL, apply_op_eq); break;
+            case BC_NOT:
+                push(apply_op_not(pop()));
+                break;
+
+            case BC_LIST:
+                push(build_list(READ_OPERAND()));
+                break;
+            case BC_MAP: {
+                uint32_t count = READ_OPERAND();
+                push(build_map(CURRENT_NODE(), count));
+                break;
+            }
+            case BC_INDEX: BINARY(apply_op_index); break;
+            case BC_SET_INDEX: {
+                Value value = pop();
+                Value index = pop();
+                Value container = pop();
+                push(apply_index_assignment(CURRENT_NODE(), container, index, value));
+                break;
+            }
+
+            case BC_JUMP: {
+                uint32_t offset = READ_OPERAND();
+                ip += offset;
+                break;
+            }
+            case BC_JUMP_IF_FALSE: {
+                uint32_t offset = READ_OPERAND();
+                Value condition = pop();
+                if (condition == FALSE_VAL || (condition != TRUE_VAL && !is_truthy(condition))) {
+                    ip += offset;
+                }
+                break;
+            }
+            case BC_LOOP: {
+                uint32_t offset = READ_OPERAND();
+                ip -= offset;
+                break;
+            }
+
+            case BC_OUT:
+                push(apply_out(CURRENT_NODE(), pop()));
+                break;
+            case BC_IN:
+                push(evaluate_in(CURRENT_NODE()));
+                break;
+            case BC_IMPORT:
+                frame->ip = ip;
+                SWITCH_FRAME(import_file(CURRENT_NODE()));
+                break;
+
+            case BC_RETURN: {
+                Value result = pop();
+                FrameKind kind = frame->kind;
+                int base = frame->base;
+                vm.frame_count--;
+
+                switch (kind) {
+                    case FRAME_SCRIPT:
+                        return result;
+                    case FRAME_IMPORT:
+                        break;
+                    case FRAME_FUNCTION:
+                        frame_destroy(stack_pop(callStack), 1);
+                        break;
+                    case FRAME_METHOD:
+                        frame_destroy(stack_pop(callStack), 1);
+                        frame_destroy(stack_pop(callStack), 0);
+                        frame_destroy(stack_pop(callStack), 0);
+                        break;
+                    case FRAME_CONSTRUCTOR: {
+                        StackFrame *fields_stack = stack_pop(callStack);
+                        Obj *obj = fields_stack->object;
+                        frame_destroy(fields_stack, 0);
+                        frame_destroy(stack_pop(callStack), 0);
+
+                        result = OBJ_VAL(obj);
+                        object_set_field(obj, intern_string("self"), result);
+                        break;
+                    }
+                }
+
+                vm.stack_top = base;
+                push(result);
+                SWITCH_FRAME(&vm.frames[vm.frame_count - 1]);
+                break;
+            }
+
+            default:
+                fprintf(stderr, "Unknown opcode %d\n", *instruction);
+                return NONE_VAL;
+        }
+    }
+
+#undef READ_OPERAND
+#undef READ_NAME
+#undef CURRENT_NODE
+#undef SWITCH_FRAME
+#undef BINARY
+#undef BINARY_INT
+}
+
+/**
+ * @brief Executes a compiled program on the bytecode virtual machine
+ * @param chunk The chunk produced by compile()
+ * @return A copy of the value of the last statement, as evaluate() returns
+ */
+Value vm_run(Chunk *chunk) {
+    init_call_stack(chunk->scope);
+
+    vm.stack_capacity = STACK_INITIAL_CAPACITY;
+    vm.stack = malloc(vm.stack_capacity * sizeof(Value));
+    vm.stack_top = 0;
+    vm.frame_capacity = FRAMES_INITIAL_CAPACITY;
+    vm.frames = malloc(vm.frame_capacity * sizeof(VMFrame));
+    vm.frame_count = 0;
+    if (!vm.stack || !vm.frames) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    gc_add_roots(&vm.stack, &vm.stack_top);
+    push_frame(chunk, 0, FRAME_SCRIPT);
+    Value result = run();
+    gc_remove_roots(&vm.stack);
+
+    Value program_return = value_copy(result);
+    cleanup();
+
+    free(vm.stack);
+    free(vm.frames);
+    vm.stack = NULL;
+    vm.frames = NULL;
+    return program_return;
+}
@@ -0,0 +1,26 @@
+# Run a sample interpreted and with --jit, failing if the output differs.
+# Called by ctest as cmake -DQUOKKA=<binary> -DSAMPLE=<file.qk> -P compare_jit.cmake
+
+foreach(mode interpreted jit)
+    if(mode STREQUAL "jit")
+        set(flags --jit)
+    else()
+        set(flags "")
+    endif()
+    # The sample is also its own input, so programs that read a line get the same one
+    execute_process(
+        COMMAND ${QUOKKA} ${flags} ${SAMPLE}
+        INPUT_FILE ${SAMPLE}
+        OUTPUT_VARIABLE ${mode}_output
+        ERROR_VARIABLE ${mode}_output
+        RESULT_VARIABLE ${mode}_status
+        TIMEOUT 60
+    )
+endforeach()
+
+if(NOT interpreted_status STREQUAL jit_status)
+    message(FATAL_ERROR "${SAMPLE}: exit status ${interpreted_status} interpreted, ${jit_status} with --jit")
+endif()
+if(NOT interpreted_output STREQUAL jit_output)
+    message(FATAL_ERROR "${SAMPLE}: output differs with --jit\n--- interpreted\n${interpreted_output}\n--- jit\n${jit_output}")
+endif()